@@ -1,3 +1,5 @@
+#ifndef MATNS_HPP
+#define MATNS_HPP
 #include <cassert>
 #include "Fonctions_Utiles.hpp"
 #include <fstream>
@@ -6,139 +8,946 @@
 # include <iomanip>
 # include <ctime>
 # include "umfpack.h"
+#include "chronos.hpp"
+#include "memoire.hpp"
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <cstdlib>
+#include <string>
+#include <chrono>
 
 using namespace std;
 
 
 typedef map< pair<int,int>,double> MatMap;
 
+//Indices des matrices creuses (Ap, AI): int et umfpack_di_* par defaut. Avec make INDICES64=1
+//(-DNS_INDICES64): SuiteSparse_long et umfpack_dl_* (l'ordonnancement CHOLMOD passe alors par
+//cholmod_l_*), pour depasser 2^31 non nuls. Les numeros de ddl restent des int.
+#ifdef NS_INDICES64
+typedef SuiteSparse_long Indice;
+#define UMF_DEFAULTS umfpack_dl_defaults
+#define UMF_SYMBOLIC umfpack_dl_symbolic
+#define UMF_QSYMBOLIC umfpack_dl_qsymbolic
+#define UMF_NUMERIC umfpack_dl_numeric
+#define UMF_SOLVE umfpack_dl_solve
+#define UMF_WSOLVE umfpack_dl_wsolve
+#define UMF_FREE_SYMBOLIC umfpack_dl_free_symbolic
+#define UMF_FREE_NUMERIC umfpack_dl_free_numeric
+#define UMF_GET_LUNZ umfpack_dl_get_lunz
+#define UMF_GET_NUMERIC umfpack_dl_get_numeric
+#else
+typedef int Indice;
+#define UMF_DEFAULTS umfpack_di_defaults
+#define UMF_SYMBOLIC umfpack_di_symbolic
+#define UMF_QSYMBOLIC umfpack_di_qsymbolic
+#define UMF_NUMERIC umfpack_di_numeric
+#define UMF_SOLVE umfpack_di_solve
+#define UMF_WSOLVE umfpack_di_wsolve
+#define UMF_FREE_SYMBOLIC umfpack_di_free_symbolic
+#define UMF_FREE_NUMERIC umfpack_di_free_numeric
+#define UMF_GET_LUNZ umfpack_di_get_lunz
+#define UMF_GET_NUMERIC umfpack_di_get_numeric
+#endif
+#include "renumerotation.hpp"
+#include "blocs.hpp"
+#include "spmv.hpp"
+#include "sansmatrice.hpp"
+
+//occupation estimee d'une MatMap: un noeud rouge-noir (3 pointeurs + couleur + valeur) par entree,
+//arrondi a 16 octets avec l'en-tete malloc
+double OctetsMap(const MatMap & M){
+	size_t noeud=(4*sizeof(void*)+sizeof(MatMap::value_type)+sizeof(size_t)+15)/16*16;
+	return (double)M.size()*noeud+sizeof(MatMap);
+}
+
+//Options UMFPACK (tableau Control) utilisees par toutes les factorisations et resolutions
+//SOLVEUR_MONOLITHIQUE: systeme P2-P1 complet factorise par UMFPACK; SOLVEUR_SCHUR: operateur de
+//vitesse scalaire factorise une fois pour u1 et u2, pression par complement de Schur (SchurVitesse)
+enum {SOLVEUR_MONOLITHIQUE, SOLVEUR_SCHUR};
+
+struct ConfigUmfpack {
+	double Control[UMFPACK_CONTROL];
+	int renumerotation; //Ordre donne a UMFPACK (ORDRE_UMFPACK: ordonnancement interne, -ordering)
+	int solveur;
+	int residu; //controle ||Ax-b||/||b|| apres chaque resolution: format SpMV ou RESIDU_SANS_MATRICE (-1: pas de controle)
+	ConfigUmfpack() : renumerotation(ORDRE_UMFPACK), solveur(SOLVEUR_MONOLITHIQUE), residu(-1) {UMF_DEFAULTS(Control);}
+	//options de la ligne de commande: -ordering amd|metis|cholmod|best|none, -strategy auto|sym|unsym,
+	//-pivtol x, -irstep k, -renumerotation umfpack|amd|camd|metis|rcm|auto, -solveur monolithique|schur,
+	//-residu csr|sell|sansmatrice; renvoie le nombre d'arguments consommes (0 si opt n'est pas une option UMFPACK)
+	int option(const string & opt, const char * valeur){
+		if(!valeur)
+			return 0;
+		string v(valeur);
+		if(opt=="-residu"){
+			if(v=="csr")
+				residu=SPMV_CSR;
+			else if(v=="sell")
+				residu=SPMV_SELL;
+			else if(v=="sansmatrice")
+				residu=RESIDU_SANS_MATRICE;
+			else
+				cout<<"format inconnu: "<<v<<endl;
+			return 1;
+		}
+		if(opt=="-solveur"){
+			if(v=="monolithique")
+				solveur=SOLVEUR_MONOLITHIQUE;
+			else if(v=="schur")
+				solveur=SOLVEUR_SCHUR;
+			else
+				cout<<"solveur inconnu: "<<v<<endl;
+			return 1;
+		}
+		if(opt=="-renumerotation"){
+			for(int i=0;i<=ORDRE_AUTO;i++){
+				if(v==nomsOrdres[i]){
+					renumerotation=i;
+					return 1;
+				}
+			}
+			cout<<"renumerotation inconnue: "<<v<<endl;
+			return 1;
+		}
+		if(opt=="-ordering"){
+			const char * noms[]={"cholmod","amd","given","metis","best","none"};
+			for(int i=0;i<6;i++){
+				if(v==noms[i] && i!=UMFPACK_ORDERING_GIVEN){
+					Control[UMFPACK_ORDERING]=i;
+					return 1;
+				}
+			}
+			cout<<"ordering inconnu: "<<v<<endl;
+			return 1;
+		}
+		if(opt=="-strategy"){
+			if(v=="auto")
+				Control[UMFPACK_STRATEGY]=UMFPACK_STRATEGY_AUTO;
+			else if(v=="unsym")
+				Control[UMFPACK_STRATEGY]=UMFPACK_STRATEGY_UNSYMMETRIC;
+			else if(v=="sym")
+				Control[UMFPACK_STRATEGY]=UMFPACK_STRATEGY_SYMMETRIC;
+			else
+				cout<<"strategie inconnue: "<<v<<endl;
+			return 1;
+		}
+		if(opt=="-pivtol"){
+			Control[UMFPACK_PIVOT_TOLERANCE]=atof(valeur);
+			return 1;
+		}
+		if(opt=="-irstep"){
+			Control[UMFPACK_IRSTEP]=atoi(valeur);
+			return 1;
+		}
+		return 0;
+	}
+};
+ConfigUmfpack configUmfpack;
+
+//Statistiques UMFPACK (tableaux Info) de chaque factorisation et resolution, pour le rapport
+//de calcul. Partagees par les threads d'un balayage (protegees par un verrou).
+class StatsUmfpack {
+public:
+	StatsUmfpack() : symboliques_(0), resolutions_(0), echecs_(0), ordre_(-1), strategie_(-1), picSymbolique_(0), flopsSolve_(0), irMax_(0), itSchur_(0), itSchurMax_(0), itVitesse_(0), resolutionsVitesse_(0), residuMax_(-1) {}
+	void symbolique(int statut, const double * Info){
+		lock_guard<mutex> l(verrou_);
+		symboliques_++;
+		Statut(statut,"symbolique");
+		ordre_=(int)Info[UMFPACK_ORDERING_USED];
+		strategie_=(int)Info[UMFPACK_STRATEGY_USED];
+		picSymbolique_=max(picSymbolique_,Info[UMFPACK_SYMBOLIC_PEAK_MEMORY]*Info[UMFPACK_SIZE_OF_UNIT]);
+	}
+	void numerique(int statut, const double * Info){
+		lock_guard<mutex> l(verrou_);
+		Statut(statut,"numerique");
+		Facto f={Info[UMFPACK_LNZ]+Info[UMFPACK_UNZ]-min(Info[UMFPACK_NROW],Info[UMFPACK_NCOL]), Info[UMFPACK_FLOPS], Info[UMFPACK_PEAK_MEMORY]*Info[UMFPACK_SIZE_OF_UNIT], Info[UMFPACK_RCOND], Info[UMFPACK_NUMERIC_TIME], statut};
+		factos_.push_back(f);
+	}
+	void resolution(int statut, const double * Info){
+		lock_guard<mutex> l(verrou_);
+		resolutions_++;
+		Statut(statut,"resolution");
+		flopsSolve_+=Info[UMFPACK_SOLVE_FLOPS];
+		irMax_=max(irMax_,(int)Info[UMFPACK_IR_TAKEN]);
+	}
+	//gradient conjugue sur le complement de Schur (-solveur schur)
+	void schur(int iterations){
+		lock_guard<mutex> l(verrou_);
+		resolutions_++;
+		itSchur_+=iterations;
+		itSchurMax_=max(itSchurMax_,iterations);
+	}
+	//gradient conjugue multigrille sur C (-multigrille): iterations pour resolutions C^-1
+	void vitesse(long iterations, int resolutions){
+		lock_guard<mutex> l(verrou_);
+		itVitesse_+=iterations;
+		resolutionsVitesse_+=resolutions;
+	}
+	//controle -residu
+	void residu(double r){
+		lock_guard<mutex> l(verrou_);
+		residuMax_=max(residuMax_,r);
+	}
+	//ordres compares par -renumerotation auto sur une matrice
+	struct Essai {
+		string ordre;
+		bool ok;
+		double nnzLU, flops, sOrdre, sSymbolique, sNumerique; //sNumerique<0: pas de factorisation (motif seul, estimations)
+	};
+	void comparaison(const vector<Essai> & essais, const string & choix){
+		lock_guard<mutex> l(verrou_);
+		comparaisons_.push_back(make_pair(choix,essais));
+	}
+	bool ecrire(const char * fichier, const ConfigUmfpack & config){
+		lock_guard<mutex> l(verrou_);
+		const char * ordres[]={"cholmod","amd","given","metis","best","none","user"};
+		ofstream f(fichier);
+		f<<"{\"control\":{\"ordering\":"<<config.Control[UMFPACK_ORDERING]<<",\"strategy\":"<<config.Control[UMFPACK_STRATEGY]
+			<<",\"pivot_tolerance\":"<<config.Control[UMFPACK_PIVOT_TOLERANCE]<<",\"irstep\":"<<config.Control[UMFPACK_IRSTEP]
+			<<",\"renumerotation\":\""<<nomsOrdres[config.renumerotation]<<"\",\"solveur\":\""<<(config.solveur==SOLVEUR_SCHUR ? "schur" : "monolithique")<<"\"},\n";
+		f<<"\"ordering_used\":\""<<(ordre_>=0 && ordre_<7 ? ordres[ordre_] : "?")<<"\",\"strategy_used\":\""
+			<<(strategie_==UMFPACK_STRATEGY_SYMMETRIC ? "symmetric" : strategie_==UMFPACK_STRATEGY_UNSYMMETRIC ? "unsymmetric" : "?")<<"\",\n";
+		double flops=0, pic=picSymbolique_, rcondMin=1e300, rcondMax=0, nnzMax=0;
+		for(unsigned int i=0;i<factos_.size();i++){
+			flops+=factos_[i].flops;
+			pic=max(pic,factos_[i].picOctets);
+			rcondMin=min(rcondMin,factos_[i].rcond);
+			rcondMax=max(rcondMax,factos_[i].rcond);
+			nnzMax=max(nnzMax,factos_[i].nnzLU);
+		}
+		f<<"\"symboliques\":"<<symboliques_<<",\"numeriques\":"<<factos_.size()<<",\"resolutions\":"<<resolutions_<<",\"echecs\":"<<echecs_
+			<<",\"nnz_LU_max\":"<<nnzMax<<",\"flops_factorisation\":"<<flops<<",\"flops_resolution\":"<<flopsSolve_
+			<<",\"pic_octets\":"<<pic<<",\"rcond_min\":"<<(factos_.empty() ? 0 : rcondMin)<<",\"rcond_max\":"<<rcondMax<<",\"raffinements_max\":"<<irMax_
+			<<",\"iterations_schur\":"<<itSchur_<<",\"iterations_schur_max\":"<<itSchurMax_;
+		if(resolutionsVitesse_>0)
+			f<<",\"iterations_vitesse\":"<<itVitesse_<<",\"resolutions_vitesse\":"<<resolutionsVitesse_;
+		if(residuMax_>=0)
+			f<<",\"residu_max\":"<<residuMax_;
+		f<<",\n";
+		f<<"\"factorisations\":[";
+		for(unsigned int i=0;i<factos_.size();i++){
+			const Facto & a=factos_[i];
+			f<<(i ? ",\n" : "\n")<<"{\"nnz_LU\":"<<a.nnzLU<<",\"flops\":"<<a.flops<<",\"pic_octets\":"<<a.picOctets<<",\"rcond\":"<<a.rcond<<",\"s\":"<<a.secondes<<",\"statut\":"<<a.statut<<"}";
+		}
+		f<<"],\n\"renumerotations\":[";
+		for(unsigned int i=0;i<comparaisons_.size();i++){
+			const vector<Essai> & e=comparaisons_[i].second;
+			f<<(i ? ",\n" : "\n")<<"{\"choix\":\""<<comparaisons_[i].first<<"\",\"essais\":[";
+			for(unsigned int j=0;j<e.size();j++){
+				f<<(j ? "," : "")<<"\n {\"ordre\":\""<<e[j].ordre<<"\",\"ok\":"<<(e[j].ok ? "true" : "false")<<",\"nnz_LU\":"<<e[j].nnzLU<<",\"flops\":"<<e[j].flops
+					<<",\"s_ordre\":"<<e[j].sOrdre<<",\"s_symbolique\":"<<e[j].sSymbolique<<",\"s_numerique\":"<<e[j].sNumerique<<"}";
+			}
+			f<<"]}";
+		}
+		f<<"]}\n";
+		if(!f)
+			cout<<"erreur: ecriture de "<<fichier<<endl;
+		return (bool)f;
+	}
+private:
+	struct Facto {
+		double nnzLU, flops, picOctets, rcond, secondes;
+		int statut;
+	};
+	mutex verrou_;
+	long symboliques_, resolutions_, echecs_;
+	int ordre_, strategie_;
+	double picSymbolique_, flopsSolve_;
+	int irMax_;
+	long itSchur_;
+	int itSchurMax_;
+	long itVitesse_, resolutionsVitesse_;
+	double residuMax_;
+	vector<Facto> factos_;
+	vector< pair<string, vector<Essai> > > comparaisons_;
+	void Statut(int statut, const char * etape){
+		if(statut==UMFPACK_OK)
+			return;
+		if(statut<0)
+			echecs_++;
+		cout<<"UMFPACK "<<etape<<": "<<(statut<0 ? "erreur " : "avertissement ")<<statut<<endl;
+	}
+};
+StatsUmfpack statsUmfpack;
+
+static double Secondes(chrono::steady_clock::time_point debut){
+	return chrono::duration<double>(chrono::steady_clock::now()-debut).count();
+}
+
+//Analyse symbolique avec la renumerotation configUmfpack.renumerotation (Ax peut etre NULL: motif seul).
+//En mode auto, chaque ordre est essaye (symbolique, et factorisation si Ax est fourni), la comparaison
+//va dans statsUmfpack et l'ordre de plus petit nnz(L+U) est retenu pour cette matrice.
+//Les ordres fournis sont symetriques: sauf -strategy explicite, ils sont donnes avec la strategie
+//symetrique (en auto, UMFPACK passe en non symetrique quand Qinit est fourni et ne garde que l'ordre
+//des colonnes, ce qui multiplie le remplissage).
+int SymboliqueRenumerotee(int taille, const Indice * Ap, const Indice * AI, const double * Ax, int debutPression, void ** Symbolic, double * Info){
+	int choix=configUmfpack.renumerotation;
+	vector<Indice> perm;
+	double Control[UMFPACK_CONTROL];
+	copy(configUmfpack.Control,configUmfpack.Control+UMFPACK_CONTROL,Control);
+	if(Control[UMFPACK_STRATEGY]==UMFPACK_STRATEGY_AUTO)
+		Control[UMFPACK_STRATEGY]=UMFPACK_STRATEGY_SYMMETRIC;
+	if(choix==ORDRE_AUTO){
+		vector<StatsUmfpack::Essai> essais;
+		double meilleur=1e300;
+		choix=ORDRE_UMFPACK;
+		for(int o=0;o<NB_ORDRES;o++){
+			StatsUmfpack::Essai e={nomsOrdres[o],false,0,0,0,0,-1};
+			chrono::steady_clock::time_point t=chrono::steady_clock::now();
+			bool ok=(o==ORDRE_UMFPACK) || CalculerOrdre((Ordre)o,taille,Ap,AI,debutPression,perm);
+			e.sOrdre=Secondes(t);
+			void * S=0, * N=0;
+			double I[UMFPACK_INFO];
+			t=chrono::steady_clock::now();
+			if(ok){
+				ok=UMFPACK_OK==((o==ORDRE_UMFPACK) ? UMF_SYMBOLIC(taille,taille,Ap,AI,Ax,&S,configUmfpack.Control,I)
+					: UMF_QSYMBOLIC(taille,taille,Ap,AI,Ax,perm.data(),&S,Control,I));
+			}
+			e.sSymbolique=Secondes(t);
+			if(ok){
+				e.nnzLU=I[UMFPACK_LNZ_ESTIMATE]+I[UMFPACK_UNZ_ESTIMATE]-taille;
+				e.flops=I[UMFPACK_FLOPS_ESTIMATE];
+				t=chrono::steady_clock::now();
+				if(Ax){
+					ok=(UMF_NUMERIC(Ap,AI,Ax,S,&N,configUmfpack.Control,I)==UMFPACK_OK);
+					e.sNumerique=Secondes(t);
+					e.nnzLU=I[UMFPACK_LNZ]+I[UMFPACK_UNZ]-taille;
+					e.flops=I[UMFPACK_FLOPS];
+					if(N)
+						UMF_FREE_NUMERIC(&N);
+				}
+				UMF_FREE_SYMBOLIC(&S);
+			}
+			e.ok=ok;
+			if(ok && e.nnzLU<meilleur){
+				meilleur=e.nnzLU;
+				choix=o;
+			}
+			essais.push_back(e);
+		}
+		statsUmfpack.comparaison(essais,nomsOrdres[choix]);
+		cout<<"renumerotation: "<<nomsOrdres[choix]<<" (nnz(L+U)="<<meilleur<<")"<<endl;
+	}
+	if(choix==ORDRE_UMFPACK || !CalculerOrdre((Ordre)choix,taille,Ap,AI,debutPression,perm))
+		return UMF_SYMBOLIC(taille,taille,Ap,AI,Ax,Symbolic,configUmfpack.Control,Info);
+	return UMF_QSYMBOLIC(taille,taille,Ap,AI,Ax,perm.data(),Symbolic,Control,Info);
+}
+
+//Ddl de Dirichlet (vitesse sur les bords 10, 20 et 40; 30 = sortie libre) et valeurs imposees,
+//calcules une fois par maillage. Leurs lignes et colonnes sont eliminees: on resout le systeme
+//reduit aux ddl libres (dans le meme ordre), les colonnes eliminees passent au second membre.
+struct Dirichlet {
+	int taille;          //systeme complet
+	vector<int> reduit;  //num dans le systeme reduit (-1: ddl impose)
+	vector<int> libre;   //ddl libres: num reduit -> num complet
+	vector<int> impose;
+	vector<double> g;    //valeur imposee pour uEntree=1 (g est lineaire en uEntree), 0 sur les ddl libres
+	Dirichlet() : taille(0) {}
+	int tailleReduite() const {return libre.size();}
+	size_t octets() const {return (reduit.capacity()+libre.capacity()+impose.capacity())*sizeof(int)+g.capacity()*sizeof(double);}
+};
+
+void ConstruireDirichlet(Mesh2d & Th, Dirichlet & D){
+	const NumerotationDdl & N=Th.ddl;
+	D.taille=N.taille();
+	D.g.assign(D.taille,0.);
+	vector<char> impose(D.taille,0);
+	for(int k=0;k<Th.nbt;k++){
+		for(int il=0;il<6;il++){
+			const Vertex & P=(il<3) ? Th.t[k].v[il] : Th.t[k].mil[il-3];
+			int lab=P.getLab().OnGamma();
+			if(lab==10||lab==20||lab==40){
+				impose[N[k][il]]=impose[N[k][il+6]]=1;
+				D.g[N[k][il]]=g(P,lab,1.);
+			}
+		}
+	}
+	D.reduit.assign(D.taille,-1);
+	D.libre.clear();
+	D.impose.clear();
+	for(int i=0;i<D.taille;i++){
+		if(impose[i])
+			D.impose.push_back(i);
+		else{
+			D.reduit[i]=D.libre.size();
+			D.libre.push_back(i);
+		}
+	}
+}
+
+//Motif creux structurel (CSR) du systeme P2-P1 reduit aux ddl libres et analyse symbolique UMFPACK
+//associee: ne depend que du maillage, il est partage par tous les cas (nu, dt, uEntree) d'un balayage
+struct MotifCreux {
+	int taille; //systeme reduit
+	vector<Indice> Ap, AI;
+	Dirichlet cl;
+	void * Symbolic;
+	MotifCreux() : taille(0), Symbolic(0) {}
+	~MotifCreux(){
+		if(Symbolic)
+			UMF_FREE_SYMBOLIC(&Symbolic);
+	}
+private:
+	MotifCreux(const MotifCreux &);
+	void operator=(const MotifCreux &);
+};
+
+//couplages non nuls de la matrice elementaire de BuildMatNS: u1-u1, u2-u2, u-p, p-u et diagonale p-p
+void ConstruireMotif(Mesh2d & Th, int n, MotifCreux & P){
+	ConstruireDirichlet(Th,P.cl);
+	const vector<int> & reduit=P.cl.reduit;
+	P.taille=P.cl.tailleReduite();
+	vector< vector<int> > lignes(P.taille);
+	for(int k=0;k<Th.nbt;k++){
+		const int * glob=Th.ddl[k];
+		for(int il=0;il<15;il++){
+			if(reduit[glob[il]]<0)
+				continue;
+			for(int jl=0;jl<15;jl++){
+				bool vitesse=(il<12 && jl<12 && il/6==jl/6);
+				bool mixte=((il<12)!=(jl<12));
+				if((vitesse || mixte || il==jl) && reduit[glob[jl]]>=0)
+					lignes[reduit[glob[il]]].push_back(reduit[glob[jl]]);
+			}
+		}
+	}
+	P.Ap.assign(P.taille+1,0);
+	P.AI.clear();
+	for(int i=0;i<P.taille;i++){
+		sort(lignes[i].begin(),lignes[i].end());
+		lignes[i].erase(unique(lignes[i].begin(),lignes[i].end()),lignes[i].end());
+		P.AI.insert(P.AI.end(),lignes[i].begin(),lignes[i].end());
+		P.Ap[i+1]=P.AI.size();
+	}
+	if(P.Symbolic)
+		UMF_FREE_SYMBOLIC(&P.Symbolic);
+	CHRONO("symbolique");
+	double Info[UMFPACK_INFO];
+	int status=SymboliqueRenumerotee(P.taille,P.Ap.data(),P.AI.data(),(double *)NULL,P.taille-Th.nv,&P.Symbolic,Info); //analyse sur le motif seul
+	statsUmfpack.symbolique(status,Info);
+	Memoire::declarer("motif",(P.Ap.capacity()+P.AI.capacity())*sizeof(Indice)+P.cl.octets());
+	Memoire::declarer("umfpack/symbolique",Info[UMFPACK_SYMBOLIC_SIZE]*Info[UMFPACK_SIZE_OF_UNIT]);
+}
+
 # define TIME_SIZE 40
 void timestamp(){
-  static char time_buffer[TIME_SIZE];
-  const struct std::tm *tm_ptr;
+  char time_buffer[TIME_SIZE];
+  struct std::tm tm_loc;
   size_t len;
   std::time_t now;
   now = std::time ( NULL );
-  tm_ptr = std::localtime ( &now );
-  len = std::strftime ( time_buffer, TIME_SIZE, "%d %B %Y %I:%M:%S %p", tm_ptr );
+  localtime_r ( &now, &tm_loc );
+  len = std::strftime ( time_buffer, TIME_SIZE, "%d %B %Y %I:%M:%S %p", &tm_loc );
   std::cout << time_buffer << "\n";
 }
 
 
-//////////////////////////////////////// Equation de Stokes stationnaire /////////////////////////
-vector<double> resolution_Stokes(Mesh2d & Th,double alpha,double nu, MatMap & M,int n,vector<double> xprec, int NS,bool MapExiste){
+//assemblage de la matrice globale dans la map (numerotation Th.ddl)
+void AssemblerMatNS(Mesh2d & Th, double alpha, double nu, MatMap & M, int n){
 	int nt=Th.nbt;
-	//ofstream StokesMatElement("MaMat.txt");
-	vector<double> solution;
-	double b[2*n+Th.nv]; //2nd membre
-	for(int i=0;i<2*n+Th.nv;i++){
-		b[i]=0; //second membre
-	}
-	if(MapExiste==0){
-		for(int k=0;k<nt;k++){
-			double A[15][15];
-			BuildMatNS(Th, alpha,nu, A,k);
-			int i,j;
-			for(int il=0;il<15;il++){//mat glob assemblage: Th(k,il) renvoie le num glob d'un sommet si il<3, et sinon d'un milieu si il<6
-				for(int jl=0;jl<15;jl++){
-					if(il<6){
-						i=Th(k,il);
-					}
-					else if(il<12){
-						i=Th(k,il-6)+n;
-					}
-					else{
-						i=Th(k,il-12)+2*n;
-					}
-					if(jl<6){
-						j=Th(k,jl);
-					}
-					else if(jl<12){
-						j=Th(k,jl-6)+n;
-					}
-					else{
-						j=Th(k,jl-12)+2*n;
-					}
-					if(fabs(A[il][jl])>1e-15){
-						M[make_pair(i,j)]+=A[il][jl];
-					}
+	for(int k=0;k<nt;k++){
+		double A[15][15];
+		BuildMatNS(Th, alpha,nu, A,k);
+		const int * glob=Th.ddl[k]; //num globaux des 15 ddl du triangle k
+		for(int il=0;il<15;il++){
+			for(int jl=0;jl<15;jl++){
+				if(fabs(A[il][jl])>1e-15){
+					M[make_pair(glob[il],glob[jl])]+=A[il][jl];
 				}
 			}
 		}
 	}
-	if(NS==1){
-		//cout<<"calcul caract"<<endl;
-		CalculCaracteristique(Th,alpha,xprec,n,b);
-	}	
-	//cout<<"fin carac "<<endl;
-	
-	/*for (std::map< pair<int,int>,double>::iterator it=M.begin(); it!=M.end(); ++it)
-  	 std::cout << it->first.first<<" "<< it->first.second<<" "<<it->second << endl;*/
-	int lab[6];//Condition aux limites
-	for(int k=0;k<nt;k++){
-		for(int il=0;il<6;il++){
-			if(il<3)
-				lab[il]=Th.t[k].v[il].getLab().OnGamma();
-			else
-				lab[il]=Th.t[k].mil[il-3].getLab().OnGamma();
-			if(lab[il]==10||lab[il]==20||lab[il]==40){//BORDS (30 = sortie) 
-				int i1,i2;
-				i1=Th(k,il);
-				i2=Th(k,il)+n;
-				if(MapExiste==0){
-					pair <int,int> key1=make_pair(i1,i1);
-					pair <int,int> key2=make_pair(i2,i2);
-					if(M.find(key1)!= M.end())//si on trouve dans la map
-						M[key1]=tgv;
-					if(M.find(key2)!= M.end())//si on trouve dans la map
-						M[key2]=tgv;
+}
+
+//conversion map -> CSR (une ligne de la map par ligne): UMFPACK la lit comme la CSC de la transposee
+void MapVersCSR(const MatMap & M, int taille, vector<Indice> & Ap, vector<Indice> & AI, vector<double> & Ax){
+	Ap.assign(taille+1,0);
+	AI.resize(M.size());
+	Ax.resize(M.size());
+	Indice cpt=0;
+	for (MatMap::const_iterator it=M.begin(); it!=M.end(); ++it)
+	{
+		AI[cpt]=it->first.second;
+		Ax[cpt]=it->second;
+		Ap[it->first.first+1] = ++ cpt;
+	}
+	for(int i=0;i<taille;i++){//lignes vides
+		Ap[i+1]=max(Ap[i+1],Ap[i]);
+	}
+}
+
+//conversion map -> CSR du systeme reduit aux ddl libres de cl; les colonnes des ddl imposes
+//sont accumulees dans relevement (A_li g, a retrancher du second membre)
+void MapVersCSRReduit(const MatMap & M, const Dirichlet & cl, double uEntree, vector<Indice> & Ap, vector<Indice> & AI, vector<double> & Ax, vector<double> & relevement){
+	int m=cl.tailleReduite();
+	Ap.assign(m+1,0);
+	AI.clear();
+	Ax.clear();
+	AI.reserve(M.size());
+	Ax.reserve(M.size());
+	relevement.assign(m,0.);
+	for (MatMap::const_iterator it=M.begin(); it!=M.end(); ++it)
+	{
+		int i=cl.reduit[it->first.first], j=cl.reduit[it->first.second];
+		if(i<0)
+			continue;
+		if(j<0)
+			relevement[i]+=it->second*uEntree*cl.g[it->first.second];
+		else{
+			AI.push_back(j);
+			Ax.push_back(it->second);
+			Ap[i+1]++;
+		}
+	}
+	for(int i=0;i<m;i++){
+		Ap[i+1]+=Ap[i];
+	}
+}
+
+//conversion blocs -> CSR du systeme reduit aux ddl libres de cl (disposition DDL_ENTRELACE): le
+//bloc vitesse C_ij I donne C_ij sur u1-u1 et u2-u2, le motif obtenu est celui de ConstruireMotif.
+//motifFixe: Ap et AI sont deja ceux du motif partage, seules les valeurs et le relevement sont ecrits.
+void BlocsVersCSRReduit(const MatBlocsNS & A, const Dirichlet & cl, double uEntree, vector<Indice> & Ap, vector<Indice> & AI, vector<double> & Ax, vector<double> & relevement, bool motifFixe){
+	int m=cl.tailleReduite(), n=A.n;
+	relevement.assign(m,0.);
+	if(motifFixe)
+		Ax.assign(AI.size(),0.);
+	else{
+		Ap.assign(m+1,0);
+		AI.clear();
+		Ax.clear();
+		AI.reserve(2*A.Aj.size()+4*A.Bj.size()+A.nv);
+		Ax.reserve(AI.capacity());
+	}
+	Indice pos=0;
+	auto terme=[&](int ir, int col, double v){
+		int jr=cl.reduit[col];
+		if(jr<0)
+			relevement[ir]+=v*uEntree*cl.g[col];
+		else if(motifFixe){
+			assert(AI[pos]==jr);
+			Ax[pos++]=v;
+		}
+		else{
+			AI.push_back(jr);
+			Ax.push_back(v);
+		}
+	};
+	for(int i=0;i<2*n;i++){//lignes de vitesse: colonnes de vitesse puis de pression, croissantes
+		int ir=cl.reduit[i], a=i/2, c=i%2;
+		if(ir<0)
+			continue;
+		for(Indice q=A.Ap[a];q<A.Ap[a+1];q++){
+			terme(ir,2*A.Aj[q]+c,A.Av[q]);
+		}
+		for(Indice q=A.Bp[a];q<A.Bp[a+1];q++){
+			terme(ir,2*n+A.Bj[q],A.Bv[2*q+c]);
+		}
+		if(!motifFixe)
+			Ap[ir+1]=AI.size();
+	}
+	for(int s=0;s<A.nv;s++){
+		int ir=cl.reduit[2*n+s];
+		if(ir<0)
+			continue;
+		for(Indice q=A.Cp[s];q<A.Cp[s+1];q++){
+			terme(ir,2*A.Cj[q],A.Cv[2*q]);
+			terme(ir,2*A.Cj[q]+1,A.Cv[2*q+1]);
+		}
+		terme(ir,2*n+s,A.D[s]);
+		if(!motifFixe)
+			Ap[ir+1]=AI.size();
+	}
+	assert(!motifFixe || pos==(Indice)AI.size());
+}
+
+#include "multigrille.hpp"
+#include "amg.hpp"
+
+//////////////////////////////////////// Vitesse scalaire et complement de Schur /////////////////////////
+// Les blocs u1-u1 et u2-u2 du systeme sont le meme operateur C = alpha M + nu K (MatBlocsNS::Av)
+// et u1, u2 sont imposees sur les memes noeuds: C reduit aux noeuds libres est factorise une seule
+// fois pour les deux composantes. Avec (f1, f2, fp) le second membre releve:
+//   C u_c + B_c p = f_c,   B1^T u1 + B2^T u2 - eps p = fp
+// la pression est solution de S p = B^T C^-1 f - fp, S = B^T C^-1 B + eps I symetrique definie
+// positive, puis u_c = C^-1 (f_c - B_c p). Gradient conjugue depuis la pression precedente,
+// preconditionne par Cahouet-Chabard: S^-1 ~ nu Mp^-1 + alpha Kp^-1 (Mp masse P1 condensee,
+// Kp laplacien P1, pression nulle sur la sortie 30 pour Kp).
+// Chaque C^-1 traite u1 et u2 ensemble: les facteurs L U extraits de UMFPACK sont parcourus une
+// fois pour les deux seconds membres, ranges entrelaces (u1,u2) par noeud. Avec -multigrille L|amg,
+// C n'est pas factorise: C^-1 par gradient conjugue preconditionne par multigrille (multigrille.hpp,
+// amg.hpp).
+struct SchurVitesse {
+	int n, nv, m;                //noeuds P2, sommets, noeuds libres
+	vector<int> reduit, libre;   //noeud -> num reduit (-1: vitesse imposee), num reduit -> noeud
+	vector<Indice> Lp, Lj, Up, Ui, P, Q; //P R C Q = L U, L par lignes, U par colonnes
+	vector<double> Lx, Ux, Rs;
+	int recip;
+	vector<double> releveU, releveP;  //C_li g (2m) et B^T_li g (nv)
+	vector<double> f, z, t;      //2m, (u1,u2) entrelaces
+	vector<double> h, r, d, Sd, zp;  //nv
+	double alpha, nu;
+	vector<double> masseP;       //Mp condensee
+	vector<Indice> Kp, Ki, Wi;   //Kp
+	vector<double> Kx, zk, W;
+	void * NumericK;
+	Multigrille mg;              //-multigrille L|amg: remplace L U
+	long itVitesse;              //iterations de gradient conjugue sur C (multigrille) depuis Resoudre
+	int resolutionsVitesse;
+	SchurVitesse() : n(0), nv(0), m(0), recip(0), alpha(0), nu(0), NumericK(0), itVitesse(0), resolutionsVitesse(0) {}
+	~SchurVitesse(){
+		if(NumericK)
+			UMF_FREE_NUMERIC(&NumericK);
+	}
+	bool factorise() const {return !Lp.empty() || !mg.vide();}
+	size_t octets() const {
+		return (Lp.capacity()+Lj.capacity()+Up.capacity()+Ui.capacity()+P.capacity()+Q.capacity())*sizeof(Indice)
+			+(reduit.capacity()+libre.capacity())*sizeof(int)
+			+(Lx.capacity()+Ux.capacity()+Rs.capacity()+releveU.capacity()+releveP.capacity()+f.capacity()+z.capacity()+t.capacity()
+			+h.capacity()+r.capacity()+d.capacity()+Sd.capacity()+zp.capacity()+masseP.capacity()+Kx.capacity()+zk.capacity()+W.capacity())*sizeof(double)
+			+(Kp.capacity()+Ki.capacity()+Wi.capacity())*sizeof(Indice)+mg.octets();
+	}
+
+	//Mp condensee et Kp (P1 sur les sommets), Kp factorise
+	void Preconditionneur(const Mesh2d & Th){
+		const GeometrieTriangles & G=Th.geo;
+		masseP.assign(nv,0.);
+		vector< vector<int> > lignes(nv);
+		for(int k=0;k<Th.nbt;k++){
+			for(int i=0;i<3;i++){
+				for(int j=0;j<3;j++){
+					lignes[Th.t[k].v[i].getNum()].push_back(Th.t[k].v[j].getNum());
+				}
+			}
+		}
+		vector<int> kj;
+		CompresserBlocs(lignes,Kp,kj);
+		Ki.assign(kj.begin(),kj.end());
+		Kx.assign(Ki.size(),0.);
+		const double gref[3][2]={{-1,-1},{1,0},{0,1}}; //gradients des lambda_i sur le triangle de reference
+		for(int k=0;k<Th.nbt;k++){
+			double aire=G.aire(k), gx[3], gy[3];
+			for(int i=0;i<3;i++){
+				gx[i]=G.inv00[k]*gref[i][0]+G.inv10[k]*gref[i][1];
+				gy[i]=G.inv01[k]*gref[i][0]+G.inv11[k]*gref[i][1];
+			}
+			for(int i=0;i<3;i++){
+				int si=Th.t[k].v[i].getNum();
+				masseP[si]+=aire/3;
+				for(int j=0;j<3;j++){
+					int sj=Th.t[k].v[j].getNum();
+					Kx[PositionBloc(Kp,kj,si,sj)]+=aire*(gx[i]*gx[j]+gy[i]*gy[j]);
 				}
-				if(il<3){
-					b[i1]=g(Th.t[k].v[il],lab[il])*tgv;  ///Conditions aux bords
-					b[i2]=0;
+			}
+		}
+		for(int i=0;i<nv;i++){//sortie: ligne et colonne remplacees par l'identite
+			if(Th.v[i].getLab().OnGamma()!=30)
+				continue;
+			for(Indice q=Kp[i];q<Kp[i+1];q++){
+				Kx[q]=(Ki[q]==i) ? 1. : 0.;
+				if(Ki[q]!=i)
+					Kx[PositionBloc(Kp,kj,Ki[q],i)]=0.;
+			}
+		}
+		if(NumericK)
+			UMF_FREE_NUMERIC(&NumericK);
+		double Info[UMFPACK_INFO];
+		void * Symbolic;
+		int status=SymboliqueRenumerotee(nv,Kp.data(),Ki.data(),Kx.data(),nv,&Symbolic,Info);
+		statsUmfpack.symbolique(status,Info);
+		status=UMF_NUMERIC(Kp.data(),Ki.data(),Kx.data(),Symbolic,&NumericK,configUmfpack.Control,Info);
+		statsUmfpack.numerique(status,Info);
+		UMF_FREE_SYMBOLIC(&Symbolic);
+		zk.resize(nv);
+		Wi.resize(nv);
+		W.resize(nv);
+	}
+
+	//z = (nu Mp^-1 + alpha Kp^-1) r
+	void Preconditionner(const double * r, double * z){
+		double Control[UMFPACK_CONTROL], Info[UMFPACK_INFO];
+		copy(configUmfpack.Control,configUmfpack.Control+UMFPACK_CONTROL,Control);
+		Control[UMFPACK_IRSTEP]=0; //W de taille nv suffit sans raffinement
+		UMF_WSOLVE(UMFPACK_A,Kp.data(),Ki.data(),Kx.data(),zk.data(),r,NumericK,Control,Info,Wi.data(),W.data());
+		for(int s=0;s<nv;s++){
+			z[s]=nu*r[s]/masseP[s]+alpha*zk[s];
+		}
+	}
+
+	//C reduit aux noeuds libres (disposition DDL_ENTRELACE: noeud a <-> ddl 2a, 2a+1), relevements
+	//des vitesses imposees, factorisation puis extraction des facteurs
+	void Factoriser(const Mesh2d & Th, const MatBlocsNS & A, const Dirichlet & cl, double alpha_, double nu_, double uEntree){
+		n=A.n;
+		nv=A.nv;
+		alpha=alpha_;
+		nu=nu_;
+		reduit.assign(n,-1);
+		libre.clear();
+		for(int a=0;a<n;a++){
+			assert((cl.reduit[2*a]<0)==(cl.reduit[2*a+1]<0));
+			if(cl.reduit[2*a]>=0){
+				reduit[a]=libre.size();
+				libre.push_back(a);
+			}
+		}
+		m=libre.size();
+		vector<Indice> Cp(m+1,0), Ci;
+		vector<double> Cx;
+		Ci.reserve(A.Aj.size());
+		Cx.reserve(A.Aj.size());
+		releveU.assign(2*m,0.);
+		for(int ra=0;ra<m;ra++){
+			int a=libre[ra];
+			for(Indice q=A.Ap[a];q<A.Ap[a+1];q++){
+				int b=A.Aj[q];
+				if(reduit[b]>=0){
+					Ci.push_back(reduit[b]);
+					Cx.push_back(A.Av[q]);
 				}
 				else{
-					b[i1]=g(Th.t[k].mil[il-3],lab[il])*tgv;
-					b[i2]=0;
-				}	
+					releveU[2*ra]+=A.Av[q]*uEntree*cl.g[2*b];
+					releveU[2*ra+1]+=A.Av[q]*uEntree*cl.g[2*b+1];
+				}
 			}
+			Cp[ra+1]=Ci.size();
 		}
+		releveP.assign(nv,0.);
+		for(int s=0;s<nv;s++){
+			for(Indice q=A.Cp[s];q<A.Cp[s+1];q++){
+				int b=A.Cj[q];
+				if(reduit[b]<0)
+					releveP[s]+=uEntree*(A.Cv[2*q]*cl.g[2*b]+A.Cv[2*q+1]*cl.g[2*b+1]);
+			}
+		}
+		if(configMultigrille.niveaux>0)
+			mg.Construire(configMultigrille.grossiers,Th,reduit,libre,Cp,Ci,Cx,alpha,nu,configMultigrille.lisseur);
+		else if(configMultigrille.algebrique)
+			mg.ConstruireAlgebrique(Cp,Ci,Cx,configMultigrille.lisseur);
+		else{
+			double Info[UMFPACK_INFO];
+			void * Symbolic, * Numeric;
+			int status=SymboliqueRenumerotee(m,Cp.data(),Ci.data(),Cx.data(),m,&Symbolic,Info);
+			statsUmfpack.symbolique(status,Info);
+			status=UMF_NUMERIC(Cp.data(),Ci.data(),Cx.data(),Symbolic,&Numeric,configUmfpack.Control,Info);
+			statsUmfpack.numerique(status,Info);
+			UMF_FREE_SYMBOLIC(&Symbolic);
+			Indice lnz, unz, nr, nc, nzud;
+			UMF_GET_LUNZ(&lnz,&unz,&nr,&nc,&nzud,Numeric);
+			Lp.resize(m+1); Lj.resize(lnz); Lx.resize(lnz);
+			Up.resize(m+1); Ui.resize(unz); Ux.resize(unz);
+			P.resize(m); Q.resize(m); Rs.resize(m);
+			Indice rec;
+			UMF_GET_NUMERIC(Lp.data(),Lj.data(),Lx.data(),Up.data(),Ui.data(),Ux.data(),P.data(),Q.data(),(double *)NULL,&rec,Rs.data(),Numeric);
+			recip=rec;
+			UMF_FREE_NUMERIC(&Numeric);
+		}
+		f.resize(2*m); z.resize(2*m); t.resize(2*m);
+		h.resize(nv); r.resize(nv); d.resize(nv); Sd.resize(nv); zp.resize(nv);
+		Preconditionneur(Th);
 	}
 
-//SparseMatrix
-	//cout << " build sparse mat " << endl;
-	int VNN=M.size();
-	int * AI=new int[VNN]; //indices des lignes
-	double * Ax=new double[VNN]; //valeurs
-	int * Ap=new int[2*n+Th.nv+1]; //nombre d'elmts non nuls par col
-	Ap[0]=0;
-	int cpt=0;
-	for (std::map< pair<int,int>, double>::iterator it=M.begin(); it!=M.end(); ++it)
-  {
-    int j = it->first.second;
-		int i= it->first.first;
-		AI[cpt]=j;
-		Ax[cpt]=it->second;
-    Ap[i+1] = ++ cpt;
+	//v <- C^-1 v pour les deux composantes (v: 2m, entrelace)
+	void Resoudre2(double * v){
+		if(!mg.vide()){
+			itVitesse+=mg.Resoudre2(v,configMultigrille.tol,configMultigrille.iterMax);
+			resolutionsVitesse++;
+			return;
+		}
+		double * w=t.data();
+		for(int k=0;k<m;k++){//w = P R v
+			double e=recip ? Rs[P[k]] : 1./Rs[P[k]];
+			w[2*k]=v[2*P[k]]*e;
+			w[2*k+1]=v[2*P[k]+1]*e;
+		}
+		for(int i=0;i<m;i++){//L (diagonale unite, dernier terme de chaque ligne)
+			double w1=w[2*i], w2=w[2*i+1];
+			for(Indice q=Lp[i];q<Lp[i+1]-1;q++){
+				w1-=Lx[q]*w[2*Lj[q]];
+				w2-=Lx[q]*w[2*Lj[q]+1];
+			}
+			w[2*i]=w1;
+			w[2*i+1]=w2;
+		}
+		for(int j=m-1;j>=0;j--){//U (diagonale en dernier dans chaque colonne)
+			Indice dg=Up[j+1]-1;
+			double w1=w[2*j]/Ux[dg], w2=w[2*j+1]/Ux[dg];
+			w[2*j]=w1;
+			w[2*j+1]=w2;
+			for(Indice q=Up[j];q<dg;q++){
+				w[2*Ui[q]]-=Ux[q]*w1;
+				w[2*Ui[q]+1]-=Ux[q]*w2;
+			}
+		}
+		for(int k=0;k<m;k++){//v = Q w
+			v[2*Q[k]]=w[2*k];
+			v[2*Q[k]+1]=w[2*k+1];
+		}
 	}
-	//cout << " FAC  sparse mat " << endl;
-	int taille = 2*n+Th.nv;
 
-  double *null = ( double * ) NULL;
-  void *Numeric;
-  int status;
-  void *Symbolic;
-  double x[taille];
+	//z = fc - B p (noeuds libres), fc=NULL: z = -B p
+	void Residu(const MatBlocsNS & A, const double * fc, const double * p){
+		for(int ra=0;ra<m;ra++){
+			int a=libre[ra];
+			double z1=fc ? fc[2*ra] : 0., z2=fc ? fc[2*ra+1] : 0.;
+			for(Indice q=A.Bp[a];q<A.Bp[a+1];q++){
+				z1-=A.Bv[2*q]*p[A.Bj[q]];
+				z2-=A.Bv[2*q+1]*p[A.Bj[q]];
+			}
+			z[2*ra]=z1;
+			z[2*ra+1]=z2;
+		}
+	}
 
-  timestamp ( );
-	//besoin seulement de solve si on passe en copie Ap AI et Ax
-  status = umfpack_di_symbolic ( taille, taille, Ap, AI, Ax, &Symbolic, null, null );
-  status = umfpack_di_numeric (Ap, AI, Ax, Symbolic, &Numeric, null, null );
-	//cout << " SOLV  sparse mat " << endl;
-  umfpack_di_free_symbolic ( &Symbolic );
-	//  Solve the linear system.
-  status = umfpack_di_solve ( UMFPACK_At, Ap, AI, Ax, x, b, Numeric, null, null );
-  umfpack_di_free_numeric ( &Numeric );
+	//y = B^T z (vitesses libres)
+	void Divergence(const MatBlocsNS & A, double * y){
+		for(int s=0;s<nv;s++){
+			double ys=0;
+			for(Indice q=A.Cp[s];q<A.Cp[s+1];q++){
+				int rb=reduit[A.Cj[q]];
+				if(rb>=0)
+					ys+=A.Cv[2*q]*z[2*rb]+A.Cv[2*q+1]*z[2*rb+1];
+			}
+			y[s]=ys;
+		}
+	}
+
+	//y = S p = B^T C^-1 B p - D p
+	void Appliquer(const MatBlocsNS & A, const double * p, double * y){
+		Residu(A,(double *)NULL,p);
+		Resoudre2(z.data());
+		Divergence(A,y);
+		for(int s=0;s<nv;s++){
+			y[s]=-y[s]-A.D[s]*p[s];
+		}
+	}
+
+	//x (taille 2n+nv, DDL_ENTRELACE) solution pour le second membre b; p0: pression de depart (ou 0)
+	int Resoudre(const MatBlocsNS & A, const Dirichlet & cl, const double * b, const double * p0, double uEntree, double * x, double tol=1e-10, int iterMax=1000){
+		double * p=x+2*n;
+		for(int s=0;s<nv;s++){
+			p[s]=p0 ? p0[s] : 0.;
+		}
+		itVitesse=0;
+		resolutionsVitesse=0;
+		//h = B^T C^-1 f - fp
+		for(int ra=0;ra<m;ra++){
+			f[2*ra]=b[2*libre[ra]]-releveU[2*ra];
+			f[2*ra+1]=b[2*libre[ra]+1]-releveU[2*ra+1];
+		}
+		for(int ra=0;ra<2*m;ra++){
+			z[ra]=f[ra];
+		}
+		Resoudre2(z.data());
+		Divergence(A,h.data());
+		for(int s=0;s<nv;s++){
+			h[s]-=b[2*n+s]-releveP[s];
+		}
+		double nh=0, rho=0, rr=0;
+		for(int s=0;s<nv;s++){
+			nh+=h[s]*h[s];
+		}
+		//r = h - S p, gradient conjugue preconditionne
+		Appliquer(A,p,Sd.data());
+		for(int s=0;s<nv;s++){
+			r[s]=h[s]-Sd[s];
+			rr+=r[s]*r[s];
+		}
+		Preconditionner(r.data(),zp.data());
+		for(int s=0;s<nv;s++){
+			d[s]=zp[s];
+			rho+=r[s]*zp[s];
+		}
+		int it=0;
+		while(rr>tol*tol*nh && it<iterMax){
+			Appliquer(A,d.data(),Sd.data());
+			double dSd=0;
+			for(int s=0;s<nv;s++){
+				dSd+=d[s]*Sd[s];
+			}
+			double a=rho/dSd;
+			rr=0;
+			for(int s=0;s<nv;s++){
+				p[s]+=a*d[s];
+				r[s]-=a*Sd[s];
+				rr+=r[s]*r[s];
+			}
+			Preconditionner(r.data(),zp.data());
+			double rho1=0;
+			for(int s=0;s<nv;s++){
+				rho1+=r[s]*zp[s];
+			}
+			for(int s=0;s<nv;s++){
+				d[s]=zp[s]+rho1/rho*d[s];
+			}
+			rho=rho1;
+			it++;
+		}
+		//u_c = C^-1 (f_c - B_c p)
+		Residu(A,f.data(),p);
+		Resoudre2(z.data());
+		for(int ra=0;ra<m;ra++){
+			x[2*libre[ra]]=z[2*ra];
+			x[2*libre[ra]+1]=z[2*ra+1];
+		}
+		for(unsigned int i=0;i<cl.impose.size();i++){
+			x[cl.impose[i]]=uEntree*cl.g[cl.impose[i]];
+		}
+		return it;
+	}
+};
+
+//||A x - b|| / ||b|| sur les lignes libres du systeme complet (x contient les valeurs imposees):
+//A est un operateur de taille cl.taille (MatBlocsNS, OperateurNS); r: tampon de taille cl.taille
+template<class Operateur>
+double ResiduLignesLibres(const Operateur & A, const Dirichlet & cl, const double * x, const double * b, double * r){
+	A.Produit(x,r);
+	double nr=0, nb=0;
+	for(int i=0;i<cl.taille;i++){
+		if(cl.reduit[i]>=0){
+			nr+=(r[i]-b[i])*(r[i]-b[i]);
+			nb+=b[i]*b[i];
+		}
+	}
+	return nb>0 ? sqrt(nr/nb) : sqrt(nr);
+}
+
+//Espace de travail persistant d'une suite de resolutions sur la meme matrice M: second membre,
+//solution, ddl de Dirichlet, CSR reduit, relevement, factorisation numerique et tableaux de
+//UMF_WSOLVE sont alloues au premier appel; quand MapExiste, les appels suivants ne refont que le
+//second membre et la descente-remontee, sans aucune allocation. prefixe distingue les espaces
+//simultanes dans Memoire ("cas<i>/" pour le balayage).
+struct EspaceNS {
+	vector<double> b, x, Ax, W;
+	vector<double> br, xr, relevement; //systeme reduit aux ddl libres
+	vector<Indice> Ap, AI, Wi;
+	Dirichlet cl; //sans motif partage
+	MatBlocsNS A; //disposition DDL_ENTRELACE: matrice assemblee par blocs (la map n'est pas utilisee)
+	SchurVitesse schur; //-solveur schur
+	SpMV spmv; //-residu csr|sell: copie du CSR reduit
+	OperateurNS op; //-residu sansmatrice
+	vector<double> r;
+	void * Numeric;
+	string cleEspace, cleSymbolique, cleNumerique; //cles Memoire
+	EspaceNS(const string & prefixe="") : Numeric(0), cleEspace(prefixe+"espace"), cleSymbolique(prefixe+"umfpack/symbolique"),
+		cleNumerique(prefixe+"umfpack/numerique") {}
+	~EspaceNS(){
+		Liberer();
+		Memoire::declarer(cleEspace,0);
+	}
+	void Liberer(){
+		if(Numeric){
+			UMF_FREE_NUMERIC(&Numeric);
+			Memoire::declarer(cleNumerique,0);
+		}
+	}
+private:
+	EspaceNS(const EspaceNS &);
+	void operator=(const EspaceNS &);
+};
+
+static void FinResolution(int NS){
   cout << "\n";
 	if(NS==0){
  	 cout << "  Computed solution Stokes\n";
@@ -147,17 +956,195 @@ vector<double> resolution_Stokes(Mesh2d & Th,double alpha,double nu, MatMap & M,
 		cout << "  Computed solution Navier - Stokes\n";
 	}
   cout << "\n";
-	
-  for ( int i = 0; i < taille; i++ ) 
-  {
-		solution.push_back(x[i]);
-  }
-
   cout << "\n";
   cout << "  Normal end of execution.\n";
   cout << "\n";
   timestamp ( );
-	return solution;
 }
 
+//////////////////////////////////////// Equation de Stokes stationnaire /////////////////////////
+//solution dans E.x (E.x peut ensuite etre echange avec xprec)
+void ResoudreNS(Mesh2d & Th,double alpha,double nu, MatMap & M,int n,const vector<double> & xprec, int NS,bool MapExiste,double uEntree,MotifCreux * motif,EspaceNS & E){
+	int taille = 2*n+Th.nv;
+	//ofstream StokesMatElement("MaMat.txt");
+	E.b.assign(taille,0.); //2nd membre
+	E.x.resize(taille);
+	double * b=E.b.data();
+	bool factorise=MapExiste && E.Numeric; //M inchangee: la factorisation precedente est reutilisee
+	bool blocs=(Th.ddl.disposition==DDL_ENTRELACE);
+	ChronoPortee chronoAssemblage("assemblage");
+	if(blocs && (MapExiste==0 || E.A.vide())){//E.A est propre a l'espace: assemblee a son premier usage
+		if(E.A.vide())
+			E.A.Motif(Th);
+		E.A.Assembler(Th,alpha,nu);
+	}
+	else if(MapExiste==0){
+		AssemblerMatNS(Th,alpha,nu,M,n);
+	}
+	chronoAssemblage.arreter();
+	if(NS==1){
+		//cout<<"calcul caract"<<endl;
+		CHRONO("caracteristiques");
+		CalculCaracteristique(Th,alpha,xprec,n,b,uEntree);
+	}	
+	//cout<<"fin carac "<<endl;
+	
+	/*for (std::map< pair<int,int>,double>::iterator it=M.begin(); it!=M.end(); ++it)
+  	 std::cout << it->first.first<<" "<< it->first.second<<" "<<it->second << endl;*/
+//SparseMatrix
+	const Dirichlet & cl=motif ? motif->cl : E.cl;
+	if(!motif && E.cl.taille!=taille){
+		CHRONO("dirichlet");
+		ConstruireDirichlet(Th,E.cl);
+	}
+	int m=cl.tailleReduite();
+	if(configUmfpack.solveur==SOLVEUR_SCHUR){//u1 et u2 par le meme facteur de C (disposition DDL_ENTRELACE)
+		assert(blocs);
+		timestamp ( );
+		if(!(MapExiste && E.schur.factorise())){
+			CHRONO("factorisation_vitesse");
+			E.schur.Factoriser(Th,E.A,cl,alpha,nu,uEntree);
+			if(configUmfpack.residu==RESIDU_SANS_MATRICE)
+				E.op.Initialiser(Th,alpha,nu);
+			if(Memoire::actif())
+				Memoire::declarer(E.cleEspace,E.A.octets()+E.schur.octets()+E.cl.octets()+(E.b.capacity()+E.x.capacity())*sizeof(double));
+		}
+		ChronoPortee chronoSolve("resolution");
+		int it=E.schur.Resoudre(E.A,cl,b,xprec.size()==(size_t)taille ? xprec.data()+2*n : 0,uEntree,E.x.data());
+		statsUmfpack.schur(it);
+		if(!E.schur.mg.vide()){
+			statsUmfpack.vitesse(E.schur.itVitesse,E.schur.resolutionsVitesse);
+			cout<<"  multigrille ("<<E.schur.mg.niveaux()<<" niveaux): "<<(double)E.schur.itVitesse/max(E.schur.resolutionsVitesse,1)
+				<<" iterations par C^-1 ("<<E.schur.resolutionsVitesse<<" resolutions)\n";
+		}
+		chronoSolve.arreter();
+		if(configUmfpack.residu>=0){//sur le systeme complet (lignes libres): colonnes imposees = relevement
+			CHRONO("residu");
+			E.r.resize(taille);
+			double res;
+			if(configUmfpack.residu==RESIDU_SANS_MATRICE)
+				res=ResiduLignesLibres(E.op,cl,E.x.data(),b,E.r.data());
+			else
+				res=ResiduLignesLibres(E.A,cl,E.x.data(),b,E.r.data());
+			statsUmfpack.residu(res);
+			cout<<"  residu ||Ax-b||/||b|| = "<<res<<" ("<<it<<" iterations)\n";
+		}
+		FinResolution(NS);
+		return;
+	}
+	Indice * AI = motif ? motif->AI.data() : E.AI.data();
+	Indice * Ap = motif ? motif->Ap.data() : E.Ap.data();
+	double Info[UMFPACK_INFO];
+	int status;
+	void *Symbolic;
+
+	timestamp ( );
+	if(!factorise){
+		E.Liberer();
+		//cout << " build sparse mat " << endl;
+		ChronoPortee chronoConversion("conversion_csc");
+		if(blocs){
+			BlocsVersCSRReduit(E.A,cl,uEntree,motif ? motif->Ap : E.Ap,motif ? motif->AI : E.AI,E.Ax,E.relevement,motif!=0);
+			Ap = motif ? motif->Ap.data() : E.Ap.data();
+			AI = motif ? motif->AI.data() : E.AI.data();
+		}
+		else if(motif){//valeurs de la map placees dans le motif partage
+			E.Ax.assign(motif->AI.size(),0.);
+			E.relevement.assign(m,0.);
+			for (std::map< pair<int,int>, double>::iterator it=M.begin(); it!=M.end(); ++it)
+			{
+				int i=cl.reduit[it->first.first], j=cl.reduit[it->first.second];
+				if(i<0)
+					continue;
+				if(j<0){
+					E.relevement[i]+=it->second*uEntree*cl.g[it->first.second];
+					continue;
+				}
+				Indice * pos=lower_bound(AI+Ap[i],AI+Ap[i+1],(Indice)j);
+				assert(pos<AI+Ap[i+1] && *pos==j);
+				E.Ax[pos-AI]=it->second;
+			}
+		}
+		else{
+			MapVersCSRReduit(M,cl,uEntree,E.Ap,E.AI,E.Ax,E.relevement);
+			Ap=E.Ap.data();
+			AI=E.AI.data();
+		}
+		chronoConversion.arreter();
+		//cout << " FAC  sparse mat " << endl;
+		//besoin seulement de solve si on passe en copie Ap AI et Ax
+		if(motif){
+			CHRONO("numerique");
+			status = UMF_NUMERIC (Ap, AI, E.Ax.data(), motif->Symbolic, &E.Numeric, configUmfpack.Control, Info );
+			statsUmfpack.numerique(status,Info);
+		}
+		else{
+			ChronoPortee chronoSymb("symbolique");
+			status = SymboliqueRenumerotee ( m, Ap, AI, E.Ax.data(), m-Th.nv, &Symbolic, Info );
+			statsUmfpack.symbolique(status,Info);
+			Memoire::declarer(E.cleSymbolique,Info[UMFPACK_SYMBOLIC_SIZE]*Info[UMFPACK_SIZE_OF_UNIT]);
+			chronoSymb.arreter();
+			CHRONO("numerique");
+			status = UMF_NUMERIC (Ap, AI, E.Ax.data(), Symbolic, &E.Numeric, configUmfpack.Control, Info );
+			statsUmfpack.numerique(status,Info);
+			//cout << " SOLV  sparse mat " << endl;
+			UMF_FREE_SYMBOLIC ( &Symbolic );
+			Memoire::declarer(E.cleSymbolique,0);
+		}
+		if(configUmfpack.residu==RESIDU_SANS_MATRICE){
+			E.op.Initialiser(Th,alpha,nu);
+			E.r.resize(taille);
+		}
+		else if(configUmfpack.residu>=0){
+			CHRONO("residu");
+			E.spmv.Construire(configUmfpack.residu,m,Ap,AI,E.Ax.data());
+			E.r.resize(m);
+		}
+		E.br.resize(m);
+		E.xr.resize(m);
+		E.Wi.resize(m);
+		E.W.resize(5*m); //5n avec raffinement iteratif
+		if(Memoire::actif()){
+			Memoire::declarer(E.cleNumerique,Info[UMFPACK_NUMERIC_SIZE]*Info[UMFPACK_SIZE_OF_UNIT]);
+			Memoire::declarer(E.cleEspace,(E.Ap.capacity()+E.AI.capacity()+E.Wi.capacity())*sizeof(Indice)+E.cl.octets()+E.A.octets()
+				+(E.Ax.capacity()+E.b.capacity()+E.x.capacity()+E.W.capacity()+E.br.capacity()+E.xr.capacity()+E.relevement.capacity())*sizeof(double));
+		}
+	}
+	ChronoPortee chronoCL("conditions_limites"); //second membre reduit: b_l - A_li g
+	for(int r=0;r<m;r++){
+		E.br[r]=b[cl.libre[r]]-E.relevement[r];
+	}
+	chronoCL.arreter();
+	//  Solve the linear system.
+	ChronoPortee chronoSolve("resolution");
+	status = UMF_WSOLVE ( UMFPACK_At, Ap, AI, E.Ax.data(), E.xr.data(), E.br.data(), E.Numeric, configUmfpack.Control, Info, E.Wi.data(), E.W.data() );
+	statsUmfpack.resolution(status,Info);
+	for(int r=0;r<m;r++){
+		E.x[cl.libre[r]]=E.xr[r];
+	}
+	for(unsigned int i=0;i<cl.impose.size();i++){
+		E.x[cl.impose[i]]=uEntree*cl.g[cl.impose[i]];
+	}
+	chronoSolve.arreter();
+	if(configUmfpack.residu>=0){
+		CHRONO("residu");
+		double res;
+		if(configUmfpack.residu==RESIDU_SANS_MATRICE)
+			res=ResiduLignesLibres(E.op,cl,E.x.data(),b,E.r.data());
+		else
+			res=ResiduRelatif(E.spmv,E.xr.data(),E.br.data(),E.r.data());
+		statsUmfpack.residu(res);
+		cout<<"  residu ||Ax-b||/||b|| = "<<res<<"\n";
+	}
+	FinResolution(NS);
+}
 
+//resolution isolee (matrice factorisee puis liberee); prefixe: voir EspaceNS
+vector<double> resolution_Stokes(Mesh2d & Th,double alpha,double nu, MatMap & M,int n,const vector<double> & xprec, int NS,bool MapExiste,double uEntree=1.,MotifCreux * motif=0,const string & prefixe=""){
+	EspaceNS E(prefixe);
+	ResoudreNS(Th,alpha,nu,M,n,xprec,NS,MapExiste,uEntree,motif,E);
+	vector<double> solution;
+	solution.swap(E.x);
+	return solution;
+}
+#endif
@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+//////////////////////////////////////// Multigrille algebrique (agregation lissee) /////////////////////////
+// Hierarchie de Multigrille construite a partir de C reduit seul (-multigrille amg), sans maillages
+// grossiers (Vanek, Mandel, Brezina):
+//  connexions fortes: |a_ij| >= theta sqrt(|a_ii a_jj|), theta = 0.08 divise par 2 a chaque niveau
+//  agregats:          1. noeud et ses voisins forts tous libres, 2. rattachement des restants a
+//                     l'agregat voisin le plus fortement connecte, 3. agregats des noeuds restants
+//  prolongation:      P = (I - omega D^-1 A) P0, P0 constante par agregat (colonnes normees),
+//                     omega = 4 / (3 lambda_max(D^-1 A))
+//  niveau grossier:   A_G = P^T A P (Galerkin)
+// jusqu'a mGrossier noeuds (UMFPACK), 12 niveaux ou un grossissement insuffisant. Les produits
+// creux (A P, P^T (A P)) sont calcules par lignes en deux passes (motif puis valeurs), repartis sur
+// les threads OpenMP; seule l'agregation est sequentielle.
+// Experimental: ne passe pas encore a l'echelle. Les iterations par C^-1 croissent avec le raffinement
+// (11.9, 12, 12, 15.5 de projet a projet_r3) et le bi-grille avec niveau grossier exact donne les memes
+// nombres (12 sur r2, 15 sur r3): la limite est l'espace grossier du premier niveau (agregats d'environ
+// 11 noeuds P2), pas theta ni le critere d'arret du grossissement.
+
+//C = A B (CSR, nl lignes, nc colonnes dans B), colonnes triees dans chaque ligne (UMFPACK)
+template<class IA, class IB, class IC>
+static void ProduitCreux(int nl, int nc, const vector<Indice> & ap, const vector<IA> & aj, const vector<double> & av,
+	const vector<Indice> & bp, const vector<IB> & bj, const vector<double> & bv, vector<Indice> & cp, vector<IC> & cj, vector<double> & cv){
+	cp.assign(nl+1,0);
+	NS_OMP_POUR
+	for(int i=0;i<nl;i++){//motif: nombre de colonnes de la ligne i
+		static thread_local vector<char> vu;
+		static thread_local vector<int> cols;
+		if(vu.size()<(size_t)nc)
+			vu.resize(nc,0);
+		cols.clear();
+		for(Indice q=ap[i];q<ap[i+1];q++){
+			for(Indice r=bp[aj[q]];r<bp[aj[q]+1];r++){
+				if(!vu[bj[r]]){
+					vu[bj[r]]=1;
+					cols.push_back(bj[r]);
+				}
+			}
+		}
+		for(unsigned int k=0;k<cols.size();k++){
+			vu[cols[k]]=0;
+		}
+		cp[i+1]=cols.size();
+	}
+	for(int i=0;i<nl;i++){
+		cp[i+1]+=cp[i];
+	}
+	cj.resize(cp[nl]);
+	cv.resize(cp[nl]);
+	NS_OMP_POUR
+	for(int i=0;i<nl;i++){//valeurs
+		static thread_local vector<Indice> pos;
+		static thread_local vector< pair<IC,double> > ligne;
+		if(pos.size()<(size_t)nc)
+			pos.resize(nc,-1);
+		ligne.clear();
+		for(Indice q=ap[i];q<ap[i+1];q++){
+			for(Indice r=bp[aj[q]];r<bp[aj[q]+1];r++){
+				int c=bj[r];
+				if(pos[c]<0){
+					pos[c]=ligne.size();
+					ligne.push_back(make_pair((IC)c,0.));
+				}
+				ligne[pos[c]].second+=av[q]*bv[r];
+			}
+		}
+		sort(ligne.begin(),ligne.end());
+		for(unsigned int k=0;k<ligne.size();k++){
+			pos[ligne[k].first]=-1;
+			cj[cp[i]+k]=ligne[k].first;
+			cv[cp[i]+k]=ligne[k].second;
+		}
+	}
+}
+
+//agregats de A (agg: noeud -> agregat); renvoie le nombre d'agregats
+static int Agreger(const NiveauMG & A, double theta, vector<int> & agg){
+	int m=A.m;
+	vector<double> diag(m,0.);
+	for(int i=0;i<m;i++){
+		for(Indice q=A.Ap[i];q<A.Ap[i+1];q++){
+			if(A.Aj[q]==i)
+				diag[i]=fabs(A.Av[q]);
+		}
+	}
+	//connexions fortes (motif de A filtre)
+	vector<Indice> sp(m+1,0);
+	vector<int> sj;
+	vector<double> sv;
+	for(int i=0;i<m;i++){
+		for(Indice q=A.Ap[i];q<A.Ap[i+1];q++){
+			int j=A.Aj[q];
+			double a=fabs(A.Av[q]);
+			if(j!=i && a>=theta*sqrt(diag[i]*diag[j])){
+				sj.push_back(j);
+				sv.push_back(a/sqrt(diag[i]*diag[j]));
+			}
+		}
+		sp[i+1]=sj.size();
+	}
+	agg.assign(m,-1);
+	int na=0;
+	for(int i=0;i<m;i++){//1. voisinages forts entierement libres
+		if(agg[i]>=0)
+			continue;
+		bool libre=true;
+		for(Indice q=sp[i];q<sp[i+1] && libre;q++){
+			libre=agg[sj[q]]<0;
+		}
+		if(!libre || sp[i]==sp[i+1])
+			continue;
+		agg[i]=na;
+		for(Indice q=sp[i];q<sp[i+1];q++){
+			agg[sj[q]]=na;
+		}
+		na++;
+	}
+	vector<int> agg1(agg);
+	for(int i=0;i<m;i++){//2. rattachement aux agregats de la phase 1
+		if(agg1[i]>=0)
+			continue;
+		double fort=0;
+		for(Indice q=sp[i];q<sp[i+1];q++){
+			if(agg1[sj[q]]>=0 && sv[q]>fort){
+				fort=sv[q];
+				agg[i]=agg1[sj[q]];
+			}
+		}
+	}
+	for(int i=0;i<m;i++){//3. noeuds restants et leurs voisins forts restants
+		if(agg[i]>=0)
+			continue;
+		agg[i]=na;
+		for(Indice q=sp[i];q<sp[i+1];q++){
+			if(agg[sj[q]]<0)
+				agg[sj[q]]=na;
+		}
+		na++;
+	}
+	return na;
+}
+
+void Multigrille::ConstruireAlgebrique(const vector<Indice> & Cp, const vector<Indice> & Ci, const vector<double> & Cx, int lisseur_){
+	const int mGrossier=200, niveauxMax=12;
+	lisseur=lisseur_;
+	vector<NiveauMG> fins(1); //du plus fin au plus grossier
+	fins[0].m=Cp.size()-1;
+	fins[0].Ap=Cp;
+	fins[0].Aj=Ci;
+	fins[0].Av=Cx;
+	double theta=0.08;
+	while(fins.back().m>mGrossier && (int)fins.size()<niveauxMax){
+		NiveauMG & A=fins.back();
+		vector<int> agg;
+		int nc=Agreger(A,theta,agg);
+		if(nc>0.9*A.m)
+			break;
+		vector<int> taille(nc,0);
+		for(int i=0;i<A.m;i++){
+			taille[agg[i]]++;
+		}
+		//P = (I - omega D^-1 A) P0
+		Diagonale(A);
+		A.d.assign(2*A.m,0.);
+		A.q.assign(2*A.m,0.);
+		A.lambda=LambdaMax(A);
+		double omega=4./(3*A.lambda);
+		vector<int> P0j(A.m);
+		vector<Indice> P0p(A.m+1);
+		vector<double> Sv(A.Av.size()), P0v(A.m);
+		NS_OMP_POUR
+		for(int i=0;i<A.m;i++){
+			for(Indice q=A.Ap[i];q<A.Ap[i+1];q++){
+				Sv[q]=(A.Aj[q]==i ? 1. : 0.)-omega*A.Dinv[i]*A.Av[q];
+			}
+			P0p[i]=i;
+			P0j[i]=agg[i];
+			P0v[i]=1./sqrt((double)taille[agg[i]]);
+		}
+		P0p[A.m]=A.m;
+		ProduitCreux(A.m,nc,A.Ap,A.Aj,Sv,P0p,P0j,P0v,A.Pp,A.Pj,A.Pv);
+		//A_G = P^T (A P)
+		vector<Indice> APp, APj, Rp;
+		vector<int> Rj;
+		vector<double> APv, Rv;
+		ProduitCreux(A.m,nc,A.Ap,A.Aj,A.Av,A.Pp,A.Pj,A.Pv,APp,APj,APv);
+		Transposer(A.m,nc,A.Pp,A.Pj,A.Pv,Rp,Rj,Rv);
+		NiveauMG G;
+		G.m=nc;
+		ProduitCreux(nc,nc,Rp,Rj,Rv,APp,APj,APv,G.Ap,G.Aj,G.Av);
+		fins.push_back(move(G)); //A invalide
+		theta*=0.5;
+	}
+	int L=fins.size();
+	niv.assign(L,NiveauMG());
+	double nnz=0;
+	cout<<"  multigrille algebrique: "<<L<<" niveaux, noeuds";
+	for(int l=0;l<L;l++){
+		swap(niv[l],fins[L-1-l]);
+		nnz+=niv[l].Ap[niv[l].m];
+		cout<<" "<<niv[l].m;
+	}
+	cout<<", complexite "<<nnz/Cp.back()<<endl;
+	Preparer();
+}
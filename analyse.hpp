@@ -0,0 +1,186 @@
+#ifndef ANALYSE_HPP
+#define ANALYSE_HPP
+#include "Fonctions_Utiles.hpp"
+#include <cassert>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//////////////////////////////////////// Analyse en cours de calcul /////////////////////////
+// Grandeurs calculees a chaque pas directement sur la solution (numerotation Th.ddl):
+// vitesse aux sondes, debit sortant sur le bord 30, energie cinetique, norme L2 de div u
+// et longueur de recirculation derriere la marche. Une ligne CSV par pas.
+// Les fonctions de base aux 7 points de quadrature sont tabulees une fois; par triangle on ne
+// lit que les facteurs geometriques de Th.geo.
+
+struct Sonde {
+	R2 P;
+	int k;   //triangle contenant P (-1 si hors du domaine)
+	R2 ref;  //P dans le triangle de reference
+};
+
+class AnalyseInSitu {
+public:
+	AnalyseInSitu(Mesh2d & Th, const vector<R2> & points, const char * fichier, int nbEchantillons=400)
+		: Th_(Th), f_(fichier){
+		R2 PtsRef[7];
+		Quadrature7(PtsRef,poids_);
+		for(int q=0;q<7;q++){
+			for(int i=0;i<6;i++){
+				phi_[q][i]=Phi(i,PtsRef[q]);
+				dxi_[q][i]=PartialPhi(i,0,PtsRef[q]);
+				deta_[q][i]=PartialPhi(i,1,PtsRef[q]);
+			}
+		}
+		for(unsigned int i=0;i<points.size();i++){
+			sondes_.push_back(Localiser(points[i]));
+			if(sondes_.back().k<0)
+				cout<<"attention: la sonde "<<points[i]<<" est hors du domaine"<<endl;
+		}
+		//aretes du bord de sortie: milieu et triangle adjacent
+		map< pair<int,int>, pair<int,int> > M;
+		for(int k=0;k<Th.nbt;k++){
+			for(int a=0;a<3;a++){
+				int s1=Th(k,(a+1)%3), s2=Th(k,(a+2)%3);
+				if(s2>s1)
+					swap(s1,s2);
+				M[make_pair(s1,s2)]=make_pair(Th(k,3+a),Th(k,a));
+			}
+		}
+		for(int i=0;i<Th.nbe;i++){
+			if(Th.e[i].lab.lab!=30)
+				continue;
+			int s1=Th.e[i].v[0].getNum(), s2=Th.e[i].v[1].getNum();
+			if(s2>s1)
+				swap(s1,s2);
+			pair<int,int> mo=M[make_pair(s1,s2)];
+			R2 A(Th.v[s1].getX(),Th.v[s1].getY()), B(Th.v[s2].getX(),Th.v[s2].getY()), C(Th.v[mo.second].getX(),Th.v[mo.second].getY());
+			R2 normale=perp(R2(A,B)); //|normale| = longueur de l'arete
+			if((normale,R2(A,C))>0)     //orientee vers l'exterieur
+				normale=-normale;
+			AreteSortie as={s1,mo.first,s2,normale};
+			sortie_.push_back(as);
+		}
+		//ligne de sondes le long du fond, de la marche a la sortie
+		double xmin=1e300,xmax=-1e300,ymin=1e300,ymax=-1e300;
+		for(int i=0;i<Th.nv;i++){
+			xmax=max(xmax,Th.v[i].getX());
+			ymin=min(ymin,Th.v[i].getY());
+			ymax=max(ymax,Th.v[i].getY());
+		}
+		for(int i=0;i<Th.nv;i++){
+			if(Th.v[i].getY()==ymin)
+				xmin=min(xmin,Th.v[i].getX());
+		}
+		double y=ymin+0.05*(ymax-ymin);
+		for(int i=0;i<nbEchantillons;i++){
+			double x=xmin+(xmax-xmin)*(i+0.5)/nbEchantillons;
+			ligne_.push_back(Localiser(R2(x,y)));
+		}
+		xMarche_=xmin;
+		f_<<"pas,temps,energie,div_L2,debit_sortie,recirculation";
+		for(unsigned int i=0;i<sondes_.size();i++){
+			f_<<",u1_"<<i<<",u2_"<<i;
+		}
+		f_<<"\n";
+	}
+
+	void analyser(const double * x, int pas, double temps){
+		//energie cinetique et divergence: quadrature a 7 points sur chaque triangle
+		const GeometrieTriangles & G=Th_.geo;
+		double energie=0, div2=0;
+		for(int k=0;k<Th_.nbt;k++){
+			double aire=G.aire(k);
+			double i00=G.inv00[k], i01=G.inv01[k], i10=G.inv10[k], i11=G.inv11[k]; //B^-1
+			const int * glob=Th_.ddl[k];
+			for(int q=0;q<7;q++){
+				double u1=0,u2=0,div=0;
+				for(int i=0;i<6;i++){
+					double dxi=dxi_[q][i], deta=deta_[q][i];
+					u1+=phi_[q][i]*x[glob[i]];
+					u2+=phi_[q][i]*x[glob[i+6]];
+					div+=(i00*dxi+i10*deta)*x[glob[i]]+(i01*dxi+i11*deta)*x[glob[i+6]];
+				}
+				energie+=aire*poids_[q]*0.5*(u1*u1+u2*u2);
+				div2+=aire*poids_[q]*div*div;
+			}
+		}
+		//debit: u.n est P2 sur l'arete, Simpson est exact
+		double debit=0;
+		for(unsigned int i=0;i<sortie_.size();i++){
+			const AreteSortie & a=sortie_[i];
+			const NumerotationDdl & D=Th_.ddl;
+			R2 u0(x[D.u1(a.s1)],x[D.u2(a.s1)]), um(x[D.u1(a.m)],x[D.u2(a.m)]), u2(x[D.u1(a.s2)],x[D.u2(a.s2)]);
+			debit+=((u0,a.normale)+4*(um,a.normale)+(u2,a.normale))/6;
+		}
+		//recirculation: premier passage de u1<0 a u1>=0 le long du fond
+		double recirculation=0;
+		bool negatif=false;
+		double xp=0,up=0;
+		for(unsigned int i=0;i<ligne_.size();i++){
+			if(ligne_[i].k<0)
+				continue;
+			double u=Evaluer(ligne_[i],x,0);
+			if(u<0)
+				negatif=true;
+			else if(negatif){
+				recirculation=xp+(ligne_[i].P.x-xp)*(-up)/(u-up)-xMarche_;
+				break;
+			}
+			xp=ligne_[i].P.x;
+			up=u;
+		}
+		f_<<pas<<","<<temps<<","<<energie<<","<<sqrt(div2)<<","<<debit<<","<<recirculation;
+		for(unsigned int i=0;i<sondes_.size();i++){
+			if(sondes_[i].k<0)
+				f_<<",nan,nan";
+			else
+				f_<<","<<Evaluer(sondes_[i],x,0)<<","<<Evaluer(sondes_[i],x,1);
+		}
+		f_<<endl;
+	}
+
+private:
+	struct AreteSortie {
+		int s1,m,s2;
+		R2 normale;
+	};
+	Mesh2d & Th_;
+	ofstream f_;
+	double phi_[7][6], dxi_[7][6], deta_[7][6], poids_[7]; //fonctions de base aux points de Quadrature7
+	vector<Sonde> sondes_, ligne_;
+	vector<AreteSortie> sortie_;
+	double xMarche_;
+
+	Sonde Localiser(R2 P){//recherche exhaustive, faite une seule fois
+		Sonde s={P,-1,R2()};
+		for(int k=0;k<Th_.nbt;k++){
+			Triangle & K=Th_.t[k];
+			double area0=det(P,K.v[1],K.v[2]);
+			double area1=det(K.v[0],P,K.v[2]);
+			double area2=det(K.v[0],K.v[1],P);
+			double d=area0+area1+area2;
+			if(min(area0/d,area1/d,area2/d)>=-1e-12){
+				s.k=k;
+				s.ref=R2(area1/d,area2/d);
+				return s;
+			}
+		}
+		return s;
+	}
+
+	double Evaluer(const Sonde & s, const double * x, int composante){//0: u1, 1: u2
+		double u=0;
+		const int * glob=Th_.ddl[s.k]+6*composante;
+		for(int i=0;i<6;i++){
+			u+=Phi(i,s.ref)*x[glob[i]];
+		}
+		return u;
+	}
+};
+#endif
@@ -0,0 +1,105 @@
+#ifndef BALAYAGE_HPP
+#define BALAYAGE_HPP
+#include "MatNS.hpp"
+#include "analyse.hpp"
+#include "memoire.hpp"
+#include "sortie.hpp"
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+//////////////////////////////////////// Balayage de parametres /////////////////////////
+// Plusieurs cas (nu, dt, uEntree, nbPas) sur un meme maillage, dans un seul processus:
+// maillage, points milieux, motif creux et analyse symbolique sont faits une fois,
+// les cas sont repartis sur nbThreads threads. Chaque cas i ecrit plot/cas<i>_analyse.csv
+// (et plot/cas<i>_sol_<t>.bin si champs, par l'EcrivainAsync propre a chaque thread: les
+// ecritures ne bloquent pas le calcul du cas).
+
+struct Cas {
+	double nu, dt, uEntree;
+	int nbPas;
+};
+
+//une ligne par cas: "nu dt uEntree nbPas", les lignes commencant par # sont ignorees
+vector<Cas> LireCas(const char * fichier){
+	vector<Cas> cas;
+	ifstream f(fichier);
+	if(!f){
+		cout<<"erreur: impossible de lire "<<fichier<<endl;
+		return cas;
+	}
+	string ligne;
+	while(getline(f,ligne)){
+		if(ligne.empty() || ligne[0]=='#')
+			continue;
+		istringstream is(ligne);
+		Cas c;
+		if(is>>c.nu>>c.dt>>c.uEntree>>c.nbPas)
+			cas.push_back(c);
+		else
+			cout<<"ligne ignoree: "<<ligne<<endl;
+	}
+	return cas;
+}
+
+//ecrivain: snapshots (0: pas de champs)
+void LancerCas(Mesh2d & Th, int n, const Cas & c, int numero, MotifCreux & motif, EcrivainAsync * ecrivain){
+	MatMap M1,M2;
+	vector<double> xprec;
+	string prefixe="plot/cas"+to_string(numero)+"_", cle="cas"+to_string(numero)+"/"; //cle: sous-systemes Memoire du cas
+	double alpha=1./c.dt;
+
+	xprec=resolution_Stokes(Th,0,c.nu,M1,n,xprec,0,0,c.uEntree,&motif,cle); //RESOLUTION STOKES
+	AnalyseInSitu insitu(Th,vector<R2>(),(prefixe+"analyse.csv").c_str());
+	bool MapExiste=false;
+	EspaceNS espace(cle); //propre au cas: pas d'allocation ni de verrou de l'allocateur apres le premier pas
+	for(int t=0;t<c.nbPas;t++){
+		ResoudreNS(Th,alpha,c.nu,M2,n,xprec,1,MapExiste,c.uEntree,&motif,espace); //RESOLUTION NAVIER-STOKES
+		xprec.swap(espace.x);
+		if(!MapExiste)
+			Memoire::declarer(cle+"matmap",OctetsMap(M1)+OctetsMap(M2));
+		MapExiste=true;
+		insitu.analyser(xprec.data(),t,(t+1)*c.dt);
+		if(ecrivain)
+			ecrivain->soumettre(prefixe+"sol_"+to_string(t)+".bin",xprec.data(),t,(t+1)*c.dt);
+	}
+	Memoire::declarer(cle+"matmap",0);
+}
+
+//renvoie false si un snapshot n'a pas pu etre ecrit
+bool Balayage(Mesh2d & Th, int n, uint64_t empreinte, const vector<Cas> & cas, int nbThreads, bool champs){
+	MotifCreux motif;
+	ConstruireMotif(Th,n,motif);
+	vector<int> perm=PermutationDdl(Th,n);
+	atomic<int> prochain(0), erreurs(0);
+	vector<thread> threads;
+	for(int i=0;i<max(nbThreads,1);i++){
+		threads.push_back(thread([&](){
+			unique_ptr<EcrivainAsync> ecrivain;
+			if(champs){
+				ecrivain.reset(new EcrivainAsync(2*n+Th.nv,n,empreinte,false));
+				ecrivain->permuter(perm);
+			}
+			for(int c=prochain++;c<(int)cas.size();c=prochain++){
+				LancerCas(Th,n,cas[c],c,motif,ecrivain.get());
+			}
+			if(ecrivain){
+				ecrivain->terminer();
+				if(!ecrivain->ok())
+					erreurs++;
+			}
+		}));
+	}
+	for(unsigned int i=0;i<threads.size();i++){
+		threads[i].join();
+	}
+	return erreurs==0;
+}
+#endif
@@ -0,0 +1,358 @@
+#include <vector>
+#include <map>
+#include <string>
+#include <memory>
+#include "MatNS.hpp"
+#include <benchmark/benchmark.h>
+
+using namespace std;
+
+//////////////////////////////////////// Micro-benchmarks des noyaux du solveur /////////////////////////
+// ./bench [options google benchmark]   (depuis la racine du depot)
+// Maillages: maillages/carre.msh, projet.msh, marche.msh et projet/marche raffines 1 et 2 fois.
+// Les compteurs elements/s et ddl/s sont des debits (par seconde de temps mesure).
+
+struct CasBench {
+	string nom;
+	unique_ptr<Mesh2d> Th;
+	int n;
+	vector<double> u; //champ de vitesse regulier, nul au bord de la boite englobante
+};
+
+static map<string, unique_ptr<CasBench> > cache;
+
+//maillage d'origine, ou raffine "niveau" fois (ecrit dans /tmp)
+static string Fichier(const string & base, int niveau){
+	if(niveau==0)
+		return base;
+	string prec=Fichier(base,niveau-1);
+	string racine=base.substr(base.find_last_of('/')+1);
+	string nom="/tmp/ns_bench_"+racine.substr(0,racine.rfind(".msh"))+"_r"+to_string(niveau)+".msh";
+	Mesh2d Th(prec.c_str());
+	Th.PointsMil();
+	Th.EcrireRaffine(nom.c_str());
+	return nom;
+}
+
+static CasBench & Charger(const string & fichier){
+	unique_ptr<CasBench> & c=cache[fichier];
+	if(c)
+		return *c;
+	c.reset(new CasBench);
+	c->nom=fichier;
+	c->Th.reset(new Mesh2d(fichier.c_str()));
+	c->n=c->Th->PointsMil();
+	Mesh2d & Th=*c->Th;
+	double x0=1e300,x1=-1e300,y0=1e300,y1=-1e300;
+	for(int i=0;i<Th.nv;i++){
+		x0=min(x0,Th.v[i].getX()); x1=max(x1,Th.v[i].getX());
+		y0=min(y0,Th.v[i].getY()); y1=max(y1,Th.v[i].getY());
+	}
+	c->u.assign(2*c->n+Th.nv,0.);
+	for(int i=0;i<c->n;i++){
+		double x=(Th.v[i].getX()-x0)/(x1-x0), y=(Th.v[i].getY()-y0)/(y1-y0);
+		double bulle=16*x*(1-x)*y*(1-y);
+		c->u[Th.ddl.u1(i)]=0.3*bulle;
+		c->u[Th.ddl.u2(i)]=0.1*bulle*(0.5-x);
+	}
+	return *c;
+}
+
+static void Debits(benchmark::State & state, const CasBench & c, double elementsParIter){
+	int taille=2*c.n+c.Th->nv;
+	state.counters["elements/s"]=benchmark::Counter(elementsParIter*state.iterations(),benchmark::Counter::kIsRate);
+	state.counters["ddl/s"]=benchmark::Counter((double)taille*state.iterations(),benchmark::Counter::kIsRate);
+	state.counters["nbt"]=c.Th->nbt;
+	state.counters["ddl"]=taille;
+}
+
+static void BM_LectureMaillage(benchmark::State & state, string fichier){
+	CasBench & c=Charger(fichier);
+	for(auto _ : state){
+		Mesh2d Th(fichier.c_str());
+		benchmark::DoNotOptimize(Th.nbt);
+	}
+	Debits(state,c,c.Th->nbt);
+}
+
+static void BM_PointsMil(benchmark::State & state, string fichier){
+	CasBench & c=Charger(fichier);
+	for(auto _ : state){
+		state.PauseTiming();
+		Mesh2d * Th=new Mesh2d(fichier.c_str());
+		state.ResumeTiming();
+		benchmark::DoNotOptimize(Th->PointsMil());
+		state.PauseTiming();
+		delete Th;
+		state.ResumeTiming();
+	}
+	Debits(state,c,c.Th->nbt);
+}
+
+static void BM_BuildMatNS(benchmark::State & state, string fichier){
+	CasBench & c=Charger(fichier);
+	double A[15][15];
+	for(auto _ : state){
+		for(int k=0;k<c.Th->nbt;k++){
+			BuildMatNS(*c.Th,10.,0.0025,A,k);
+			benchmark::DoNotOptimize(A[0][0]);
+		}
+	}
+	Debits(state,c,c.Th->nbt);
+}
+
+static void BM_Assemblage(benchmark::State & state, string fichier){
+	CasBench & c=Charger(fichier);
+	for(auto _ : state){
+		MatMap M;
+		AssemblerMatNS(*c.Th,10.,0.0025,M,c.n);
+		benchmark::DoNotOptimize(M.size());
+	}
+	Debits(state,c,c.Th->nbt);
+}
+
+static void BM_ConversionCSR(benchmark::State & state, string fichier){
+	CasBench & c=Charger(fichier);
+	MatMap M;
+	AssemblerMatNS(*c.Th,10.,0.0025,M,c.n);
+	vector<Indice> Ap,AI;
+	vector<double> Ax;
+	for(auto _ : state){
+		MapVersCSR(M,2*c.n+c.Th->nv,Ap,AI,Ax);
+		benchmark::DoNotOptimize(Ax.data());
+	}
+	Debits(state,c,c.Th->nbt);
+	state.counters["nnz"]=M.size();
+}
+
+static void BM_AssemblageBlocs(benchmark::State & state, string fichier){
+	CasBench & c=Charger(fichier);
+	MatBlocsNS A;
+	A.Motif(*c.Th);
+	for(auto _ : state){
+		A.Assembler(*c.Th,10.,0.0025);
+		benchmark::DoNotOptimize(A.Av.data());
+	}
+	Debits(state,c,c.Th->nbt);
+	state.counters["octets"]=A.octets();
+}
+
+//produit matrice-vecteur, CSR scalaire (disposition DDL_BLOCS) et blocs 2x2 (DDL_ENTRELACE)
+static void BM_ProduitCSR(benchmark::State & state, string fichier){
+	CasBench & c=Charger(fichier);
+	MatMap M;
+	AssemblerMatNS(*c.Th,10.,0.0025,M,c.n);
+	int taille=2*c.n+c.Th->nv;
+	vector<Indice> Ap,AI;
+	vector<double> Ax,x(taille,1.),y(taille);
+	MapVersCSR(M,taille,Ap,AI,Ax);
+	for(auto _ : state){
+		for(int i=0;i<taille;i++){
+			double s=0;
+			for(Indice q=Ap[i];q<Ap[i+1];q++){
+				s+=Ax[q]*x[AI[q]];
+			}
+			y[i]=s;
+		}
+		benchmark::DoNotOptimize(y.data());
+	}
+	Debits(state,c,c.Th->nbt);
+	state.counters["octets"]=(Ap.capacity()+AI.capacity())*sizeof(Indice)+Ax.capacity()*sizeof(double);
+}
+
+static void BM_ProduitBlocs(benchmark::State & state, string fichier){
+	CasBench & c=Charger(fichier);
+	MatBlocsNS A;
+	A.Motif(*c.Th);
+	A.Assembler(*c.Th,10.,0.0025);
+	vector<double> x(A.taille(),1.),y(A.taille());
+	for(auto _ : state){
+		A.Produit(x.data(),y.data());
+		benchmark::DoNotOptimize(y.data());
+	}
+	Debits(state,c,c.Th->nbt);
+	state.counters["octets"]=A.octets();
+}
+
+//operateur sans matrice (sansmatrice.hpp) sur le systeme complet; octets/s comparable a BM_SpMVCSR
+static void BM_ProduitSansMatrice(benchmark::State & state, string fichier){
+	CasBench & c=Charger(fichier);
+	OperateurNS A;
+	A.Initialiser(*c.Th,10.,0.0025);
+	vector<double> x(A.taille(),1.),y(A.taille());
+	for(auto _ : state){
+		A.Produit(x.data(),y.data());
+		benchmark::DoNotOptimize(y.data());
+	}
+	Debits(state,c,c.Th->nbt);
+	state.counters["octets/s"]=benchmark::Counter(A.octets()*state.iterations(),benchmark::Counter::kIsRate);
+}
+
+static void BM_CalculCaracteristique(benchmark::State & state, string fichier){
+	CasBench & c=Charger(fichier);
+	vector<double> b(2*c.n+c.Th->nv);
+	for(auto _ : state){
+		fill(b.begin(),b.end(),0.);
+		CalculCaracteristique(*c.Th,10.,c.u,c.n,b.data());
+		benchmark::DoNotOptimize(b.data());
+	}
+	Debits(state,c,c.Th->nbt);
+}
+
+//localisation des pieds des caracteristiques (points de quadrature deplaces par -u/alpha)
+static void BM_RecupVoisins(benchmark::State & state, string fichier){
+	CasBench & c=Charger(fichier);
+	Mesh2d & Th=*c.Th;
+	R2 PtsRef[7];
+	double Poids[7];
+	Quadrature7(PtsRef,Poids);
+	vector<R2> requetes(7*Th.nbt);
+	R2 Point[7];
+	double u1[6],u2[6];
+	for(int k=0;k<Th.nbt;k++){
+		PointK(Th,k,Point);
+		recup(Th.ddl,k,c.u,u1,u2);
+		for(int q=0;q<7;q++){
+			requetes[7*k+q]=Point[q]-R2(vitesseInterpolee(u1,PtsRef[q]),vitesseInterpolee(u2,PtsRef[q]))*0.1;
+		}
+	}
+	R2 ref;
+	for(auto _ : state){
+		for(int k=0;k<Th.nbt;k++){
+			for(int q=0;q<7;q++){
+				benchmark::DoNotOptimize(RecupVoisins(Th,k,requetes[7*k+q],ref));
+			}
+		}
+	}
+	Debits(state,c,7.*Th.nbt);
+}
+
+//phases UMFPACK sur le systeme NS assemble, reduit aux ddl libres (comme dans ResoudreNS)
+struct SystemeBench {
+	vector<Indice> Ap,AI;
+	vector<double> Ax,b,relevement;
+	int taille;
+};
+
+static void Systeme(CasBench & c, SystemeBench & S){
+	MatMap M;
+	Mesh2d & Th=*c.Th;
+	AssemblerMatNS(Th,10.,0.0025,M,c.n);
+	Dirichlet cl;
+	ConstruireDirichlet(Th,cl);
+	MapVersCSRReduit(M,cl,1.,S.Ap,S.AI,S.Ax,S.relevement);
+	S.taille=cl.tailleReduite();
+	S.b.assign(S.taille,1.);
+}
+
+//moteur SpMV (spmv.hpp) sur le systeme reduit; debit en octets/s a comparer a BM_Triade
+static void ProduitSpMV(benchmark::State & state, string fichier, int format){
+	CasBench & c=Charger(fichier);
+	SystemeBench S;
+	Systeme(c,S);
+	SpMV A;
+	A.Construire(format,S.taille,S.Ap.data(),S.AI.data(),S.Ax.data());
+	vector<double> y(S.taille);
+	for(auto _ : state){
+		A.Produit(S.b.data(),y.data());
+		benchmark::DoNotOptimize(y.data());
+	}
+	Debits(state,c,c.Th->nbt);
+	state.counters["octets/s"]=benchmark::Counter(A.octets()*state.iterations(),benchmark::Counter::kIsRate);
+	state.counters["remplissage"]=A.remplissage(S.Ap[S.taille]);
+}
+
+static void BM_SpMVCSR(benchmark::State & state, string fichier){
+	ProduitSpMV(state,fichier,SPMV_CSR);
+}
+
+static void BM_SpMVSELL(benchmark::State & state, string fichier){
+	ProduitSpMV(state,fichier,SPMV_SELL);
+}
+
+//a = b + s c sur 3 x 16M doubles: bande passante memoire de reference
+static void BM_Triade(benchmark::State & state){
+	long n=1L<<24;
+	vector<double> a(n), b(n,1.), c(n,2.);
+	double * pa=a.data(), * pb=b.data(), * pc=c.data();
+	for(auto _ : state){
+		NS_OMP_POUR
+		for(long i=0;i<n;i++){
+			pa[i]=pb[i]+3.*pc[i];
+		}
+		benchmark::DoNotOptimize(pa);
+	}
+	state.counters["octets/s"]=benchmark::Counter(3.*n*sizeof(double)*state.iterations(),benchmark::Counter::kIsRate);
+}
+
+static void BM_UmfpackSymbolique(benchmark::State & state, string fichier){
+	CasBench & c=Charger(fichier);
+	SystemeBench S;
+	Systeme(c,S);
+	double *null=(double *)NULL;
+	for(auto _ : state){
+		void * Symbolic;
+		UMF_SYMBOLIC(S.taille,S.taille,S.Ap.data(),S.AI.data(),S.Ax.data(),&Symbolic,null,null);
+		UMF_FREE_SYMBOLIC(&Symbolic);
+	}
+	Debits(state,c,c.Th->nbt);
+}
+
+static void BM_UmfpackNumerique(benchmark::State & state, string fichier){
+	CasBench & c=Charger(fichier);
+	SystemeBench S;
+	Systeme(c,S);
+	double *null=(double *)NULL;
+	void * Symbolic;
+	UMF_SYMBOLIC(S.taille,S.taille,S.Ap.data(),S.AI.data(),S.Ax.data(),&Symbolic,null,null);
+	for(auto _ : state){
+		void * Numeric;
+		UMF_NUMERIC(S.Ap.data(),S.AI.data(),S.Ax.data(),Symbolic,&Numeric,null,null);
+		UMF_FREE_NUMERIC(&Numeric);
+	}
+	UMF_FREE_SYMBOLIC(&Symbolic);
+	Debits(state,c,c.Th->nbt);
+}
+
+static void BM_UmfpackResolution(benchmark::State & state, string fichier){
+	CasBench & c=Charger(fichier);
+	SystemeBench S;
+	Systeme(c,S);
+	double *null=(double *)NULL;
+	void * Symbolic, * Numeric;
+	vector<double> x(S.taille);
+	UMF_SYMBOLIC(S.taille,S.taille,S.Ap.data(),S.AI.data(),S.Ax.data(),&Symbolic,null,null);
+	UMF_NUMERIC(S.Ap.data(),S.AI.data(),S.Ax.data(),Symbolic,&Numeric,null,null);
+	for(auto _ : state){
+		UMF_SOLVE(UMFPACK_At,S.Ap.data(),S.AI.data(),S.Ax.data(),x.data(),S.b.data(),Numeric,null,null);
+		benchmark::DoNotOptimize(x.data());
+	}
+	UMF_FREE_NUMERIC(&Numeric);
+	UMF_FREE_SYMBOLIC(&Symbolic);
+	Debits(state,c,c.Th->nbt);
+}
+
+int main(int argc, char ** argv){
+	vector<string> maillages;
+	maillages.push_back("maillages/carre.msh");
+	maillages.push_back("projet.msh");
+	maillages.push_back("marche.msh");
+	for(int niveau=1;niveau<=2;niveau++){
+		maillages.push_back(Fichier("projet.msh",niveau));
+		maillages.push_back(Fichier("marche.msh",niveau));
+	}
+	typedef void (*Noyau)(benchmark::State &, string);
+	const char * noms[]={"LectureMaillage","PointsMil","BuildMatNS","Assemblage","ConversionCSR","AssemblageBlocs","ProduitCSR","ProduitBlocs","ProduitSansMatrice","CalculCaracteristique","RecupVoisins","SpMVCSR","SpMVSELL","UmfpackSymbolique","UmfpackNumerique","UmfpackResolution"};
+	Noyau noyaux[]={BM_LectureMaillage,BM_PointsMil,BM_BuildMatNS,BM_Assemblage,BM_ConversionCSR,BM_AssemblageBlocs,BM_ProduitCSR,BM_ProduitBlocs,BM_ProduitSansMatrice,BM_CalculCaracteristique,BM_RecupVoisins,BM_SpMVCSR,BM_SpMVSELL,BM_UmfpackSymbolique,BM_UmfpackNumerique,BM_UmfpackResolution};
+	for(unsigned int i=0;i<sizeof(noyaux)/sizeof(noyaux[0]);i++){
+		for(unsigned int m=0;m<maillages.size();m++){
+			string nom=string(noms[i])+"/"+maillages[m].substr(maillages[m].find_last_of('/')+1);
+			benchmark::RegisterBenchmark(nom.c_str(),noyaux[i],maillages[m])->Unit(benchmark::kMillisecond);
+		}
+	}
+	benchmark::RegisterBenchmark("Triade",BM_Triade)->Unit(benchmark::kMillisecond);
+	benchmark::Initialize(&argc,argv);
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+//////////////////////////////////////// Matrice par blocs de noeuds (BSR) /////////////////////////
+// Systeme P2-P1 en disposition DDL_ENTRELACE ((u1,u2) par noeud P2 puis p) stocke par blocs:
+//  A: vitesse-vitesse, blocs 2x2 (u1,u2)x(u1,u2) entre noeuds P2. BuildMatNS ne couple pas les
+//     composantes et ecrit le meme operateur C = alpha M + nu K pour u1 et u2: le bloc vaut C_ij I
+//     et seule la valeur scalaire C_ij est gardee (une valeur par bloc, appliquee aux deux composantes)
+//  B: vitesse-pression, blocs 2x1 (noeud P2 x sommet), 2 valeurs par bloc
+//  C: pression-vitesse, blocs 1x2 (sommet x noeud P2), 2 valeurs par bloc
+//  D: diagonale pression-pression (BuildMatNS n'a pas d'autre terme p-p)
+// Chaque partie est un CSR de blocs (pointeurs de ligne, un indice de colonne par bloc): un
+// indice et une valeur pour les deux termes non nuls d'un bloc vitesse au lieu de deux en CSR scalaire.
+// Le motif ne depend que du maillage (Motif); l'assemblage ajoute les matrices elementaires de
+// BuildMatNS directement dans les blocs, sans passer par la map.
+// (necessite Fonctions_Utiles.hpp et le type Indice de MatNS.hpp)
+
+struct MatBlocsNS {
+	int n, nv;
+	vector<Indice> Ap, Bp, Cp;
+	vector<int> Aj, Bj, Cj;
+	vector<double> Av, Bv, Cv, D;
+	MatBlocsNS() : n(0), nv(0) {}
+	bool vide() const {return n==0;}
+	int taille() const {return 2*n+nv;}
+	size_t octets() const {
+		return (Ap.capacity()+Bp.capacity()+Cp.capacity())*sizeof(Indice)+(Aj.capacity()+Bj.capacity()+Cj.capacity())*sizeof(int)
+			+(Av.capacity()+Bv.capacity()+Cv.capacity()+D.capacity())*sizeof(double);
+	}
+	void Motif(const Mesh2d & Th);
+	void Assembler(const Mesh2d & Th, double alpha, double nu);
+	void Produit(const double * x, double * y) const; //y = M x, x et y en disposition DDL_ENTRELACE
+};
+
+//noeuds P2 (sommets puis milieux) et sommets du triangle k
+static void NoeudsTriangle(const Mesh2d & Th, int k, int * noeud){
+	for(int i=0;i<6;i++){
+		noeud[i]=(i<3) ? Th.t[k].v[i].getNum() : Th.t[k].mil[i-3].getNum();
+	}
+}
+
+//CSR de blocs a partir des listes de colonnes de chaque ligne
+static void CompresserBlocs(vector< vector<int> > & lignes, vector<Indice> & p, vector<int> & j){
+	p.assign(lignes.size()+1,0);
+	j.clear();
+	for(unsigned int i=0;i<lignes.size();i++){
+		sort(lignes[i].begin(),lignes[i].end());
+		lignes[i].erase(unique(lignes[i].begin(),lignes[i].end()),lignes[i].end());
+		j.insert(j.end(),lignes[i].begin(),lignes[i].end());
+		p[i+1]=j.size();
+	}
+}
+
+void MatBlocsNS::Motif(const Mesh2d & Th){
+	n=Th.v.size();
+	nv=Th.nv;
+	vector< vector<int> > lignesA(n), lignesB(n), lignesC(nv);
+	int noeud[6];
+	for(int k=0;k<Th.nbt;k++){
+		NoeudsTriangle(Th,k,noeud);
+		for(int a=0;a<6;a++){
+			for(int b=0;b<6;b++){
+				lignesA[noeud[a]].push_back(noeud[b]);
+			}
+			for(int c=0;c<3;c++){
+				lignesB[noeud[a]].push_back(noeud[c]);
+				lignesC[noeud[c]].push_back(noeud[a]);
+			}
+		}
+	}
+	CompresserBlocs(lignesA,Ap,Aj);
+	CompresserBlocs(lignesB,Bp,Bj);
+	CompresserBlocs(lignesC,Cp,Cj);
+	Av.assign(Aj.size(),0.);
+	Bv.assign(2*Bj.size(),0.);
+	Cv.assign(2*Cj.size(),0.);
+	D.assign(nv,0.);
+}
+
+//position du bloc (i,j) dans un CSR de blocs
+static inline Indice PositionBloc(const vector<Indice> & p, const vector<int> & jj, int i, int j){
+	const int * pos=lower_bound(jj.data()+p[i],jj.data()+p[i+1],j);
+	assert(pos<jj.data()+p[i+1] && *pos==j);
+	return pos-jj.data();
+}
+
+//meme filtre que AssemblerMatNS (termes elementaires negligeables ignores)
+static inline void AjouterTerme(double & m, double a){
+	if(fabs(a)>1e-15)
+		m+=a;
+}
+
+void MatBlocsNS::Assembler(const Mesh2d & Th, double alpha, double nu){
+	fill(Av.begin(),Av.end(),0.);
+	fill(Bv.begin(),Bv.end(),0.);
+	fill(Cv.begin(),Cv.end(),0.);
+	fill(D.begin(),D.end(),0.);
+	int noeud[6];
+	double A[15][15];
+	for(int k=0;k<Th.nbt;k++){
+		BuildMatNS(Th,alpha,nu,A,k);
+		NoeudsTriangle(Th,k,noeud);
+		for(int a=0;a<6;a++){
+			for(int b=0;b<6;b++){
+				AjouterTerme(Av[PositionBloc(Ap,Aj,noeud[a],noeud[b])],A[a][b]); //A[a+6][b+6]==A[a][b]
+			}
+			for(int c=0;c<3;c++){
+				double * m=&Bv[2*PositionBloc(Bp,Bj,noeud[a],noeud[c])];
+				AjouterTerme(m[0],A[a][12+c]);
+				AjouterTerme(m[1],A[a+6][12+c]);
+				m=&Cv[2*PositionBloc(Cp,Cj,noeud[c],noeud[a])];
+				AjouterTerme(m[0],A[12+c][a]);
+				AjouterTerme(m[1],A[12+c][a+6]);
+			}
+		}
+		for(int c=0;c<3;c++){
+			AjouterTerme(D[noeud[c]],A[12+c][12+c]);
+		}
+	}
+}
+
+void MatBlocsNS::Produit(const double * x, double * y) const {
+	const double * p=x+2*n;
+	for(int i=0;i<n;i++){
+		double y1=0, y2=0;
+		for(Indice q=Ap[i];q<Ap[i+1];q++){
+			y1+=Av[q]*x[2*Aj[q]];
+			y2+=Av[q]*x[2*Aj[q]+1];
+		}
+		for(Indice q=Bp[i];q<Bp[i+1];q++){
+			y1+=Bv[2*q]*p[Bj[q]];
+			y2+=Bv[2*q+1]*p[Bj[q]];
+		}
+		y[2*i]=y1;
+		y[2*i+1]=y2;
+	}
+	for(int s=0;s<nv;s++){
+		double ys=D[s]*p[s];
+		for(Indice q=Cp[s];q<Cp[s+1];q++){
+			ys+=Cv[2*q]*x[2*Cj[q]]+Cv[2*q+1]*x[2*Cj[q]+1];
+		}
+		y[2*n+s]=ys;
+	}
+}
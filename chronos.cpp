@@ -0,0 +1,335 @@
+#include "chronos.hpp"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+using namespace std;
+
+bool Chronometrage::actif_=false;
+
+namespace {
+	typedef chrono::steady_clock Horloge;
+
+	typedef ResumePhase Cumul;
+	struct Evenement {
+		string nom;
+		int tid;
+		double debut, duree; //microsecondes depuis l'activation
+	};
+	struct Ouvert {
+		const char * nom;
+		Horloge::time_point t0;
+		long pic;
+		bool picFiable; //false: VmHWM n'a pas pu etre remis a zero a l'ouverture
+		double c0[NB_COMPTEURS];
+	};
+
+	//groupe perf_event du thread courant (meneur: cycles), ouvert a la premiere phase
+	struct GroupeCompteurs {
+		int meneur; //-1: indisponible
+		int fd[NB_COMPTEURS];
+		int position[NB_COMPTEURS]; //rang dans la lecture de groupe, -1 si absent
+		int nb;
+		bool essaye;
+		GroupeCompteurs() : meneur(-1), nb(0), essaye(false) {
+			for(int i=0;i<NB_COMPTEURS;i++)
+				fd[i]=position[i]=-1;
+		}
+		~GroupeCompteurs(){
+			for(int i=NB_COMPTEURS-1;i>=0;i--){
+				if(fd[i]>=0)
+					close(fd[i]);
+			}
+		}
+	};
+
+	mutex verrou;
+	bool avecTrace=false;
+	bool avecMemoire=false;
+	bool avecCompteurs=false;
+	atomic<bool> compteursSignales(false);
+	mutex verrouPic; //lecture et remise a zero de VmHWM, compte des phases ouvertes
+	long picProcessus=0; //max des VmHWM lus: le pic du processus survit aux remises a zero
+	int phasesOuvertes=0; //tous threads confondus (avecMemoire)
+	Horloge::time_point origine;
+	map<string,Cumul> total, pasCourant;
+	vector< pair<int, map<string,Cumul> > > parPas;
+	vector<Evenement> evenements;
+	map<int,string> nomsThreads;
+	atomic<int> prochainTid(0);
+
+	thread_local vector<Ouvert> pile;
+	thread_local int tid=-1;
+	thread_local GroupeCompteurs groupe;
+
+	void OuvrirCompteurs(){
+		groupe.essaye=true;
+		static const uint64_t configs[NB_COMPTEURS]={PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_REFERENCES,
+			PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES};
+		for(int i=0;i<NB_COMPTEURS;i++){
+			struct perf_event_attr attr;
+			memset(&attr,0,sizeof(attr));
+			attr.size=sizeof(attr);
+			attr.type=PERF_TYPE_HARDWARE;
+			attr.config=configs[i];
+			attr.exclude_kernel=1;
+			attr.exclude_hv=1;
+			attr.disabled=(i==0);
+			attr.read_format=PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			int fd=syscall(__NR_perf_event_open,&attr,0,-1,i==0 ? -1 : groupe.meneur,0); //thread courant, tout cpu
+			if(fd<0){
+				if(i==0){
+					if(!compteursSignales.exchange(true))
+						cout<<"compteurs materiels indisponibles (perf_event_open: "<<strerror(errno)<<")"<<endl;
+					return;
+				}
+				continue;
+			}
+			if(i==0)
+				groupe.meneur=fd;
+			groupe.fd[i]=fd;
+			groupe.position[i]=groupe.nb++;
+		}
+		ioctl(groupe.meneur,PERF_EVENT_IOC_ENABLE,PERF_IOC_FLAG_GROUP);
+	}
+
+	//valeurs courantes (corrigees du multiplexage), -1 si indisponibles
+	void LireCompteurs(double * c){
+		for(int i=0;i<NB_COMPTEURS;i++)
+			c[i]=-1;
+		if(!groupe.essaye)
+			OuvrirCompteurs();
+		if(groupe.meneur<0)
+			return;
+		uint64_t tampon[3+NB_COMPTEURS]; //nb, temps actif, temps compte, valeurs
+		if(read(groupe.meneur,tampon,sizeof(tampon))<(ssize_t)(3*sizeof(uint64_t)) || tampon[2]==0)
+			return;
+		double echelle=(double)tampon[1]/tampon[2];
+		for(int i=0;i<NB_COMPTEURS;i++){
+			if(groupe.position[i]>=0)
+				c[i]=tampon[3+groupe.position[i]]*echelle;
+		}
+	}
+
+	long LirePicKo(){//VmHWM de /proc/self/status
+		ifstream f("/proc/self/status");
+		string mot;
+		while(f>>mot){
+			if(mot=="VmHWM:"){
+				long ko=0;
+				f>>ko;
+				return ko;
+			}
+		}
+		return 0;
+	}
+
+	void RemettrePicAZero(){
+		ofstream f("/proc/self/clear_refs");
+		f<<"5";
+	}
+
+	int Tid(){
+		if(tid<0)
+			tid=prochainTid++;
+		return tid;
+	}
+
+	void EcrireCumuls(ostream & f, const map<string,Cumul> & m){
+		f<<"{";
+		for(map<string,Cumul>::const_iterator it=m.begin(); it!=m.end(); ++it){
+			f<<(it==m.begin() ? "" : ",")<<"\""<<it->first<<"\":{\"s\":"<<it->second.secondes<<",\"appels\":"<<it->second.appels;
+			if(avecMemoire){
+				f<<",\"pic_ko\":"<<it->second.picKo;
+				if(!it->second.picFiable)
+					f<<",\"pic_fiable\":false";
+			}
+			const double * c=it->second.compteurs;
+			if(avecCompteurs && c[CYCLES]>=0){
+				static const char * noms[NB_COMPTEURS]={"cycles","instructions","llc_references","llc_defauts","branchements","branchements_rates"};
+				for(int i=0;i<NB_COMPTEURS;i++){
+					if(c[i]>=0)
+						f<<",\""<<noms[i]<<"\":"<<c[i];
+				}
+				if(c[INSTRUCTIONS]>=0 && c[CYCLES]>0)
+					f<<",\"ipc\":"<<c[INSTRUCTIONS]/c[CYCLES];
+				if(c[LLC_DEFAUTS]>=0 && c[LLC_REFERENCES]>0)
+					f<<",\"taux_defauts_llc\":"<<c[LLC_DEFAUTS]/c[LLC_REFERENCES];
+				if(c[BRANCHEMENTS_RATES]>=0 && c[BRANCHEMENTS]>0)
+					f<<",\"taux_branchements_rates\":"<<c[BRANCHEMENTS_RATES]/c[BRANCHEMENTS];
+			}
+			f<<"}";
+		}
+		f<<"}";
+	}
+}
+
+void Chronometrage::activer(bool trace, bool memoire, bool compteurs){
+	lock_guard<mutex> l(verrou);
+	avecTrace=trace;
+	avecMemoire=memoire;
+	avecCompteurs=compteurs;
+	origine=Horloge::now();
+	actif_=true;
+}
+
+void Chronometrage::debut(const char * nom){
+	Ouvert o={nom,Horloge::now(),0,true,{0}};
+	if(avecMemoire){//le pic courant est reporte sur les phases ouvertes avant la remise a zero
+		lock_guard<mutex> l(verrouPic);
+		long pic=LirePicKo();
+		picProcessus=max(picProcessus,pic);
+		for(unsigned int i=0;i<pile.size();i++){
+			pile[i].pic=max(pile[i].pic,pic);
+		}
+		//clear_refs vaut pour tout le processus: pas de remise a zero si un autre thread a une
+		//phase ouverte (son pic serait efface); la nouvelle phase herite alors du pic anterieur
+		if(phasesOuvertes==(int)pile.size())
+			RemettrePicAZero();
+		else
+			o.picFiable=false;
+		phasesOuvertes++;
+	}
+	if(avecCompteurs){
+		LireCompteurs(o.c0);
+		o.t0=Horloge::now(); //le temps de lecture n'est pas compte dans la phase
+	}
+	pile.push_back(o);
+}
+
+void Chronometrage::fin(){
+	if(pile.empty())
+		return;
+	Horloge::time_point t1=Horloge::now();
+	double dc[NB_COMPTEURS];
+	if(avecCompteurs){
+		LireCompteurs(dc);
+		for(int i=0;i<NB_COMPTEURS;i++){
+			dc[i]=(dc[i]>=0 && pile.back().c0[i]>=0) ? max(dc[i]-pile.back().c0[i],0.) : -1;
+		}
+	}
+	string chemin;
+	for(unsigned int i=0;i<pile.size();i++){
+		chemin+=(i ? "/" : "");
+		chemin+=pile[i].nom;
+	}
+	Horloge::time_point t0=pile.back().t0;
+	long pic=0;
+	bool picFiable=pile.back().picFiable;
+	if(avecMemoire){
+		lock_guard<mutex> l(verrouPic);
+		pic=max(pile.back().pic,LirePicKo());
+		picProcessus=max(picProcessus,pic);
+		for(unsigned int i=0;i+1<pile.size();i++){
+			pile[i].pic=max(pile[i].pic,pic);
+		}
+		phasesOuvertes--;
+	}
+	pile.pop_back();
+	double s=chrono::duration<double>(t1-t0).count();
+	int id=Tid();
+	lock_guard<mutex> l(verrou);
+	total[chemin].secondes+=s;
+	total[chemin].appels++;
+	total[chemin].picKo=max(total[chemin].picKo,pic);
+	total[chemin].picFiable=total[chemin].picFiable && picFiable;
+	pasCourant[chemin].secondes+=s;
+	pasCourant[chemin].appels++;
+	pasCourant[chemin].picKo=max(pasCourant[chemin].picKo,pic);
+	pasCourant[chemin].picFiable=pasCourant[chemin].picFiable && picFiable;
+	if(avecCompteurs){
+		for(int i=0;i<NB_COMPTEURS;i++){
+			if(dc[i]<0)
+				continue;
+			total[chemin].compteurs[i]=max(total[chemin].compteurs[i],0.)+dc[i];
+			pasCourant[chemin].compteurs[i]=max(pasCourant[chemin].compteurs[i],0.)+dc[i];
+		}
+	}
+	if(avecTrace){
+		Evenement e={chemin.substr(chemin.rfind('/')+1),id,chrono::duration<double,micro>(t0-origine).count(),s*1e6};
+		evenements.push_back(e);
+	}
+}
+
+long Chronometrage::picProcessusKo(){
+	lock_guard<mutex> l(verrouPic);
+	return max(picProcessus,LirePicKo());
+}
+
+map<string,ResumePhase> Chronometrage::totaux(){
+	lock_guard<mutex> l(verrou);
+	return total;
+}
+
+void Chronometrage::reinitialiser(){
+	lock_guard<mutex> l(verrou);
+	total.clear();
+	pasCourant.clear();
+	parPas.clear();
+	evenements.clear();
+}
+
+void Chronometrage::nommerThread(const char * nom){
+	int id=Tid();
+	lock_guard<mutex> l(verrou);
+	nomsThreads[id]=nom;
+}
+
+void Chronometrage::finPas(int pas){
+	if(!actif_)
+		return;
+	lock_guard<mutex> l(verrou);
+	parPas.push_back(make_pair(pas,pasCourant));
+	pasCourant.clear();
+}
+
+bool Chronometrage::ecrireResume(const char * fichier){
+	lock_guard<mutex> l(verrou);
+	ofstream f(fichier);
+	f<<"{\"total\":";
+	EcrireCumuls(f,total);
+	f<<",\n\"pas\":[";
+	for(unsigned int i=0;i<parPas.size();i++){
+		f<<(i ? ",\n" : "\n")<<"{\"pas\":"<<parPas[i].first<<",\"phases\":";
+		EcrireCumuls(f,parPas[i].second);
+		f<<"}";
+	}
+	f<<"]}\n";
+	if(!f)
+		cout<<"erreur: ecriture de "<<fichier<<endl;
+	return (bool)f;
+}
+
+bool Chronometrage::ecrireTrace(const char * fichier){
+	lock_guard<mutex> l(verrou);
+	ofstream f(fichier);
+	f<<"{\"traceEvents\":[";
+	bool premier=true;
+	for(map<int,string>::iterator it=nomsThreads.begin(); it!=nomsThreads.end(); ++it){
+		f<<(premier ? "\n" : ",\n")<<"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"<<it->first<<",\"args\":{\"name\":\""<<it->second<<"\"}}";
+		premier=false;
+	}
+	f.precision(15);
+	for(unsigned int i=0;i<evenements.size();i++){
+		const Evenement & e=evenements[i];
+		f<<(premier ? "\n" : ",\n")<<"{\"name\":\""<<e.nom<<"\",\"ph\":\"X\",\"pid\":1,\"tid\":"<<e.tid<<",\"ts\":"<<e.debut<<",\"dur\":"<<e.duree<<"}";
+		premier=false;
+	}
+	f<<"\n],\"displayTimeUnit\":\"ms\"}\n";
+	if(!f)
+		cout<<"erreur: ecriture de "<<fichier<<endl;
+	return (bool)f;
+}
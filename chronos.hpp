@@ -0,0 +1,74 @@
+#ifndef CHRONOS_HPP
+#define CHRONOS_HPP
+
+//////////////////////////////////////// Chronometrage des phases /////////////////////////
+// Minuteurs a portee, imbriques par thread: une phase ouverte pendant une autre est
+// cumulee sous le chemin "parent/enfant". Les temps sont agreges par pas (finPas) dans
+// un resume JSON; la trace optionnelle (format Chrome trace / Perfetto) garde chaque
+// intervalle avec une piste par thread. Inactif (un test de booleen) si non active.
+// Avec memoire=true, le pic de RSS de chaque phase est mesure (Linux: VmHWM remis a zero
+// a l'ouverture de chaque phase via /proc/self/clear_refs). La remise a zero vaut pour tout
+// le processus: elle est sautee si un autre thread a une phase ouverte, et le pic de la
+// nouvelle phase est alors marque non fiable (majorant). picProcessusKo garde le maximum de
+// tous les VmHWM lus, c'est-a-dire le pic du processus malgre les remises a zero.
+// Avec compteurs=true, chaque thread ouvre des compteurs materiels perf_event (cycles,
+// instructions, references/defauts LLC, branchements/mauvaises predictions) lus a
+// l'ouverture et a la fermeture de chaque phase; le resume donne aussi IPC et taux de
+// defauts. Si perf_event_open est refuse ou sans PMU, les compteurs sont simplement absents.
+
+#include <map>
+#include <string>
+
+enum {CYCLES, INSTRUCTIONS, LLC_REFERENCES, LLC_DEFAUTS, BRANCHEMENTS, BRANCHEMENTS_RATES, NB_COMPTEURS};
+
+struct ResumePhase {
+	double secondes;
+	long appels;
+	long picKo; //pic de RSS pendant la phase (ko), 0 si non mesure
+	bool picFiable; //false si VmHWM n'a pas ete remis a zero a une ouverture (autre thread)
+	double compteurs[NB_COMPTEURS]; //cumul des compteurs materiels, -1 si indisponible
+	ResumePhase() : secondes(0), appels(0), picKo(0), picFiable(true) {
+		for(int i=0;i<NB_COMPTEURS;i++)
+			compteurs[i]=-1;
+	}
+};
+
+class Chronometrage {
+public:
+	static void activer(bool trace, bool memoire=false, bool compteurs=false);
+	static std::map<std::string,ResumePhase> totaux();
+	static long picProcessusKo(); //pic de RSS du processus (ko), remises a zero comprises
+	static void reinitialiser(); //oublie les temps deja cumules
+	static bool actif() {return actif_;}
+	static void debut(const char * nom);
+	static void fin();
+	static void nommerThread(const char * nom); //nom de la piste du thread courant dans la trace
+	static void finPas(int pas); //cloture les temps du pas courant
+	static bool ecrireResume(const char * fichier);
+	static bool ecrireTrace(const char * fichier);
+private:
+	static bool actif_;
+};
+
+class ChronoPortee {
+public:
+	ChronoPortee(const char * nom) : enCours_(Chronometrage::actif()) {
+		if(enCours_)
+			Chronometrage::debut(nom);
+	}
+	~ChronoPortee(){arreter();}
+	void arreter(){
+		if(enCours_)
+			Chronometrage::fin();
+		enCours_=false;
+	}
+private:
+	bool enCours_;
+	ChronoPortee(const ChronoPortee &);
+	void operator=(const ChronoPortee &);
+};
+
+#define CHRONO_CONCAT2(a,b) a##b
+#define CHRONO_CONCAT(a,b) CHRONO_CONCAT2(a,b)
+#define CHRONO(nom) ChronoPortee CHRONO_CONCAT(chrono_,__LINE__)(nom)
+#endif
@@ -0,0 +1,211 @@
+#include <vector>
+#include <map>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include "MatNS.hpp"
+#include "chronos.hpp"
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+using namespace std;
+
+//////////////////////////////////////// Mise a l'echelle /////////////////////////
+// Resolution Stokes + quelques pas NS sur une suite de maillages raffines uniformement,
+// chaque taille dans un processus fils (pic de RSS propre a la taille). Comme NS, un seul
+// EspaceNS: premier_pas factorise, les pas suivants (phase pas) reutilisent la factorisation.
+// Pour chaque phase on ajuste temps ~ C ddl^p et pic memoire ~ C' ddl^q (moindres carres
+// en log-log).
+// usage: echelle maillage.msh [-niveaux K] [-pas P] [-ddlmax N] [-rapport fichier.json]
+
+struct Mesure {
+	string fichier;
+	int nbt, ddl;
+	long rssMaxKo;
+	map<string,ResumePhase> phases;
+};
+
+//maillage raffine "niveau" fois, ecrit dans /tmp
+static string Fichier(const string & base, int niveau){
+	if(niveau==0)
+		return base;
+	string prec=Fichier(base,niveau-1);
+	string racine=base.substr(base.find_last_of('/')+1);
+	string nom="/tmp/ns_echelle_"+racine.substr(0,racine.rfind(".msh"))+"_r"+to_string(niveau)+".msh";
+	Mesh2d Th(prec.c_str());
+	Th.PointsMil();
+	Th.EcrireRaffine(nom.c_str());
+	return nom;
+}
+
+//execute dans le fils: ecrit les mesures sur fd, une phase par ligne
+static void Executer(const string & fichier, int nbPas, int fd){
+	Chronometrage::activer(false,true);
+	ChronoPortee chronoLecture("lecture_maillage");
+	Mesh2d Th(fichier.c_str());
+	chronoLecture.arreter();
+	ChronoPortee chronoMil("PointsMil");
+	int n=Th.PointsMil();
+	chronoMil.arreter();
+	double nu=0.0025, alpha=10.;
+	MatMap M1,M2;
+	vector<double> xprec;
+	{
+		CHRONO("stokes");
+		xprec=resolution_Stokes(Th,0,nu,M1,n,xprec,0,0);
+	}
+	EspaceNS espace; //comme NS: factorisation gardee d'un pas a l'autre
+	for(int t=0;t<nbPas;t++){
+		CHRONO(t==0 ? "premier_pas" : "pas"); //pas: regime etabli (second membre et descente-remontee)
+		ResoudreNS(Th,alpha,nu,M2,n,xprec,1,t>0,1.,0,espace);
+		xprec.swap(espace.x);
+	}
+	ostringstream os;
+	os<<Th.nbt<<" "<<2*n+Th.nv<<"\n";
+	map<string,ResumePhase> ph=Chronometrage::totaux();
+	for(map<string,ResumePhase>::iterator it=ph.begin(); it!=ph.end(); ++it){
+		os<<it->first<<" "<<it->second.secondes<<" "<<it->second.appels<<" "<<it->second.picKo<<"\n";
+	}
+	string s=os.str();
+	if(write(fd,s.data(),s.size())!=(ssize_t)s.size())
+		exit(1);
+}
+
+static bool Mesurer(const string & fichier, int nbPas, Mesure & m){
+	int tube[2];
+	if(pipe(tube)!=0)
+		return false;
+	pid_t pid=fork();
+	if(pid==0){
+		close(tube[0]);
+		freopen("/dev/null","w",stdout); //les impressions du solveur
+		Executer(fichier,nbPas,tube[1]);
+		close(tube[1]);
+		_exit(0);
+	}
+	close(tube[1]);
+	string donnees;
+	char tampon[4096];
+	ssize_t lu;
+	while((lu=read(tube[0],tampon,sizeof(tampon)))>0){
+		donnees.append(tampon,lu);
+	}
+	close(tube[0]);
+	int statut;
+	struct rusage ru;
+	if(wait4(pid,&statut,0,&ru)<0 || !WIFEXITED(statut) || WEXITSTATUS(statut)!=0){
+		cout<<"erreur: echec du calcul sur "<<fichier<<endl;
+		return false;
+	}
+	m.fichier=fichier;
+	m.rssMaxKo=ru.ru_maxrss;
+	istringstream is(donnees);
+	is>>m.nbt>>m.ddl;
+	string phase;
+	ResumePhase r;
+	while(is>>phase>>r.secondes>>r.appels>>r.picKo){
+		m.phases[phase]=r;
+	}
+	return true;
+}
+
+//pente de log(y) en fonction de log(x) (moindres carres); nan si moins de 2 points
+static double Exposant(const vector<double> & x, const vector<double> & y){
+	double sx=0,sy=0,sxx=0,sxy=0;
+	int k=0;
+	for(unsigned int i=0;i<x.size();i++){
+		if(x[i]<=0 || y[i]<=0)
+			continue;
+		double lx=log(x[i]), ly=log(y[i]);
+		sx+=lx; sy+=ly; sxx+=lx*lx; sxy+=lx*ly;
+		k++;
+	}
+	if(k<2 || k*sxx-sx*sx<=0)
+		return sqrt(-1.);
+	return (k*sxy-sx*sy)/(k*sxx-sx*sx);
+}
+
+static void EcrireNombre(ostream & f, double x){
+	if(x!=x)
+		f<<"null";
+	else
+		f<<x;
+}
+
+int main(int argc, const char ** argv){
+	if(argc<2){
+		cout<<"usage: "<<argv[0]<<" maillage.msh [-niveaux K] [-pas P] [-ddlmax N] [-rapport fichier.json]"<<endl;
+		return 1;
+	}
+	int niveaux=3, nbPas=3;
+	long ddlMax=3000000;
+	const char * rapport="echelle.json";
+	for(int a=2;a<argc;a++){
+		string opt(argv[a]);
+		if(opt=="-niveaux" && a+1<argc)
+			niveaux=atoi(argv[++a]);
+		else if(opt=="-pas" && a+1<argc)
+			nbPas=atoi(argv[++a]);
+		else if(opt=="-ddlmax" && a+1<argc)
+			ddlMax=atol(argv[++a]);
+		else if(opt=="-rapport" && a+1<argc)
+			rapport=argv[++a];
+		else
+			cout<<"option inconnue: "<<opt<<endl;
+	}
+
+	vector<Mesure> mesures;
+	for(int niveau=0;niveau<=niveaux;niveau++){
+		string fichier=Fichier(argv[1],niveau);
+		Mesure m;
+		if(!Mesurer(fichier,nbPas,m))
+			break;
+		cout<<fichier<<": nbt="<<m.nbt<<" ddl="<<m.ddl<<" pas="<<m.phases["pas"].secondes/max(nbPas,1)<<" s rss="<<m.rssMaxKo<<" ko"<<endl;
+		mesures.push_back(m);
+		if(4L*m.ddl>ddlMax) //le raffinement suivant multiplie les ddl par ~4
+			break;
+	}
+
+	map<string,int> phases;
+	for(unsigned int i=0;i<mesures.size();i++){
+		for(map<string,ResumePhase>::iterator it=mesures[i].phases.begin(); it!=mesures[i].phases.end(); ++it){
+			phases[it->first]=1;
+		}
+	}
+	ofstream f(rapport);
+	f<<"{\"maillages\":[";
+	for(unsigned int i=0;i<mesures.size();i++){
+		Mesure & m=mesures[i];
+		f<<(i ? ",\n" : "\n")<<"{\"fichier\":\""<<m.fichier<<"\",\"nbt\":"<<m.nbt<<",\"ddl\":"<<m.ddl<<",\"rss_max_ko\":"<<m.rssMaxKo<<",\"phases\":{";
+		for(map<string,ResumePhase>::iterator it=m.phases.begin(); it!=m.phases.end(); ++it){
+			f<<(it==m.phases.begin() ? "" : ",")<<"\""<<it->first<<"\":{\"s_par_appel\":"<<it->second.secondes/it->second.appels
+				<<",\"appels\":"<<it->second.appels<<",\"pic_ko\":"<<it->second.picKo<<"}";
+		}
+		f<<"}}";
+	}
+	f<<"],\n\"exposants\":{";
+	cout<<"phase: exposant temps / exposant memoire (en fonction des ddl)"<<endl;
+	for(map<string,int>::iterator it=phases.begin(); it!=phases.end(); ++it){
+		vector<double> x,t,mem;
+		for(unsigned int i=0;i<mesures.size();i++){
+			map<string,ResumePhase>::iterator p=mesures[i].phases.find(it->first);
+			if(p==mesures[i].phases.end())
+				continue;
+			x.push_back(mesures[i].ddl);
+			t.push_back(p->second.secondes/p->second.appels);
+			mem.push_back(p->second.picKo);
+		}
+		double et=Exposant(x,t), em=Exposant(x,mem);
+		f<<(it==phases.begin() ? "\n" : ",\n")<<"\""<<it->first<<"\":{\"temps\":";
+		EcrireNombre(f,et);
+		f<<",\"memoire\":";
+		EcrireNombre(f,em);
+		f<<"}";
+		cout<<"  "<<it->first<<": "<<et<<" / "<<em<<endl;
+	}
+	f<<"}}\n";
+	cout<<"rapport: "<<rapport<<endl;
+	return 0;
+}
@@ -3,6 +3,13 @@
 #include <fstream>
 #include <map>
 #include "MatNS.hpp"
+#include "analyse.hpp"
+#include "sortie.hpp"
+#include "chronos.hpp"
+#include "memoire.hpp"
+#include "balayage.hpp"
+#include "xdmf.hpp"
+#include "reprise.hpp"
 #include <cstdlib>
 #include <iostream>
 #include <iomanip>
@@ -18,89 +25,265 @@ int  main(int argc, const char** argv)
   double nu = 0.0025;
 	double dt=0.1;
 	double alpha=1./dt;
+	int nbPas=80;
 	vector<double> xprec;
 	vector<double> X;
+	bool simple=false; //snapshots en float32
+	bool xdmf=false; //sortie XDMF/HDF5 plot/NS.xmf + plot/NS.h5
+	int compression=0;
+	int periodeReprise=10; //point de reprise tous les periodeReprise pas (0: jamais)
+	bool reprise=false;
+	const char * fichierReprise="plot/reprise.bin";
+	bool champs=true; //snapshots complets a chaque pas
+	bool analyse=false; //series temporelles dans plot/analyse.csv
+	vector<R2> sondes;
+	const char * fichierCas=0; //balayage de parametres
+	int nbThreads=thread::hardware_concurrency();
+	const char * fichierChronos=0; //resume JSON des temps par phase et par pas
+	const char * fichierTrace=0;   //trace Chrome/Perfetto
+	const char * fichierUmfpack=0; //statistiques UMFPACK (Info) de chaque factorisation
+	const char * fichierMemoire=0; //octets par sous-systeme et pic de RSS par phase
+	bool compteurs=false; //compteurs materiels perf_event par phase (dans le resume -timers)
+	int courbe=COURBE_AUCUNE; //reordonnement des sommets et triangles a la lecture
+	int disposition=DDL_BLOCS; //disposition des ddl dans les vecteurs et la matrice du solveur
+	for(int a=2;a<argc;a++){
+		string opt(argv[a]);
+		if(opt=="-float")
+			simple=true;
+		else if(opt=="-xdmf")
+			xdmf=true;
+		else if(opt=="-compression" && a+1<argc)
+			compression=atoi(argv[++a]);
+		else if(opt=="-checkpoint" && a+1<argc)
+			periodeReprise=atoi(argv[++a]);
+		else if(opt=="--restart")
+			reprise=true;
+		else if(opt=="-analyse")
+			analyse=true;
+		else if(opt=="-probe" && a+2<argc){
+			sondes.push_back(R2(atof(argv[a+1]),atof(argv[a+2])));
+			a+=2;
+			analyse=true;
+		}
+		else if(opt=="-nofields")
+			champs=false;
+		else if(opt=="-sweep" && a+1<argc)
+			fichierCas=argv[++a];
+		else if(opt=="-threads" && a+1<argc)
+			nbThreads=atoi(argv[++a]);
+		else if(opt=="-timers" && a+1<argc)
+			fichierChronos=argv[++a];
+		else if(opt=="-trace" && a+1<argc)
+			fichierTrace=argv[++a];
+		else if(opt=="-courbe" && a+1<argc){
+			string c(argv[++a]);
+			if(c=="hilbert")
+				courbe=COURBE_HILBERT;
+			else if(c=="morton")
+				courbe=COURBE_MORTON;
+			else
+				cout<<"courbe inconnue: "<<c<<endl;
+		}
+		else if(opt=="-ddl" && a+1<argc){
+			string d(argv[++a]);
+			if(d=="blocs")
+				disposition=DDL_BLOCS;
+			else if(d=="entrelace")
+				disposition=DDL_ENTRELACE;
+			else
+				cout<<"disposition inconnue: "<<d<<endl;
+		}
+		else if(opt=="-perf")
+			compteurs=true;
+		else if(opt=="-memoire" && a+1<argc)
+			fichierMemoire=argv[++a];
+		else if(opt=="-umfpack" && a+1<argc)
+			fichierUmfpack=argv[++a];
+		else if(configUmfpack.option(opt,a+1<argc ? argv[a+1] : 0)) //-ordering, -strategy, -pivtol, -irstep, -renumerotation, -solveur
+			a++;
+		else if(configMultigrille.option(opt,a+1<argc ? argv[a+1] : 0)) //-multigrille, -lisseur
+			a++;
+		else
+			cout<<"option inconnue: "<<opt<<endl;
+	}
+	if(configMultigrille.algebrique)
+		cout<<"-multigrille amg: option experimentale (iterations croissantes avec le raffinement, plus lent que L U)"<<endl;
+	if(configMultigrille.actif() && configUmfpack.solveur!=SOLVEUR_SCHUR){
+		cout<<"-multigrille: solveur schur (multigrille sur le bloc vitesse)"<<endl;
+		configUmfpack.solveur=SOLVEUR_SCHUR;
+	}
+	if(configMultigrille.niveaux>0 && courbe!=COURBE_AUCUNE){
+		cout<<"-multigrille: -courbe ignore (la prolongation suit la numerotation de EcrireRaffine)"<<endl;
+		courbe=COURBE_AUCUNE;
+	}
+	if(configUmfpack.solveur==SOLVEUR_SCHUR && disposition!=DDL_ENTRELACE){
+		cout<<"-solveur schur: ddl entrelaces (matrice par blocs)"<<endl;
+		disposition=DDL_ENTRELACE;
+	}
+	if(fichierMemoire)
+		Memoire::activer();
+	if(compteurs && !fichierChronos)
+		cout<<"-perf: les compteurs sont ecrits dans le resume -timers"<<endl;
+	if(fichierChronos || fichierTrace || fichierMemoire){
+		Chronometrage::activer(fichierTrace!=0,fichierMemoire!=0,compteurs);
+		Chronometrage::nommerThread("solveur");
+	}
 	cout << " lecture de " << argv[1] << endl;
-  Mesh2d Th(argv[1]);
+	ChronoPortee chronoLecture("lecture_maillage");
+	string fichierMaillage=argv[1];
+	if(configMultigrille.niveaux>0){//maillage lu = niveau grossier, calcul sur le niveau le plus fin
+		fichierMaillage=configMultigrille.Hierarchie(argv[1]);
+		cout<<" maillage de calcul: "<<fichierMaillage<<endl;
+	}
+  Mesh2d Th(fichierMaillage.c_str());
+	chronoLecture.arreter();
+	uint64_t empreinte=Th.empreinte(); //du maillage lu: les sorties restent dans sa numerotation
+	if(courbe!=COURBE_AUCUNE){
+		CHRONO("reordonnement");
+		Th.Reordonner(courbe);
+	}
+	ChronoPortee chronoMil("PointsMil");
 	int n=Th.PointsMil();
-
-	X=resolution_Stokes(Th,0,nu,M1,n,xprec,0,0); //RESOLUTION STOKES
-
-	ofstream file("plot/solution.txt");
-	int i;
-
-	for(int k=0;k<Th.nbt;k++){
-		for(int il=0;il<15;il++){
-			if(il<6){
-				i=Th(k,il);
-				file<<X[i]<<" ";
-			}
-			else if(il<12){
-				i=Th(k,il-6);
-				file<<X[i+n]<<" ";
-			}
-			else{
-				i=Th(k,il-12);
-				file<<X[i+2*n]<<" ";
-			}
-		}
-		
-		file<<"\n";
+	if(disposition!=DDL_BLOCS)
+		Th.NumeroterDdl(disposition);
+	chronoMil.arreter();
+	int taille=2*n+Th.nv;
+	if(Memoire::actif()){
+		OctetsMaillage o=Th.octets();
+		Memoire::declarer("maillage/sommets",o.sommets);
+		Memoire::declarer("maillage/triangles",o.triangles);
+		Memoire::declarer("maillage/aretes",o.aretes);
+		Memoire::declarer("maillage/voisins",o.voisins);
+		Memoire::declarer("maillage/geometrie",o.geometrie);
+		Memoire::declarer("maillage/ddl",o.ddl);
+		Memoire::declarer("maillage/autres",o.autres);
 	}
-	file.close();
-	xprec=X;
+	if(fichierCas){
+		vector<Cas> cas=LireCas(fichierCas);
+		bool ok=Balayage(Th,n,empreinte,cas,nbThreads,champs);
+		if(fichierChronos)
+			Chronometrage::ecrireResume(fichierChronos);
+		if(fichierTrace)
+			Chronometrage::ecrireTrace(fichierTrace);
+		if(fichierUmfpack)
+			statsUmfpack.ecrire(fichierUmfpack,configUmfpack);
+		if(fichierMemoire)
+			Memoire::ecrire(fichierMemoire);
+		return ok ? 0 : 1;
+	}
+	vector<int> perm=PermutationDdl(Th,n); //numerotation de sortie (vide si non reordonne)
+	EcrivainAsync ecrivain(taille,n,empreinte,simple); //ecriture des snapshots en tache de fond
+	ecrivain.permuter(perm);
 
-	ofstream file1("plot/sol_0.txt");
-	cout<< "pas de temps 0"<<endl;
-	M2.clear();
-	X=resolution_Stokes(Th,alpha,nu,M2,n,xprec,1,0); //RESOLUTION NAVIER-STOKES
-	xprec=X;
-	for(int k=0;k<Th.nbt;k++){
-		for(int il=0;il<15;il++){
-			if(il<6){
-				i=Th(k,il);
-				file1<<xprec[i]<<" ";
-			}
-			else if(il<12){
-				i=Th(k,il-6);
-				file1<<xprec[i+n]<<" ";
-			}
-			else{
-				i=Th(k,il-12);
-				file1<<xprec[i+2*n]<<" ";
-			}
+	PointReprise r;
+	int debut=0; //premier pas a calculer
+	if(reprise){
+		if(!LireReprise(fichierReprise,r))
+			return 1;
+		if(r.empreinte!=empreinte || r.n!=n || (int)r.xprec.size()!=taille){
+			cout<<"erreur: le point de reprise ne correspond pas au maillage "<<argv[1]<<endl;
+			return 1;
 		}
-		file1<<"\n";
+		if(r.dt!=dt || r.nu!=nu){
+			cout<<"erreur: point de reprise calcule avec dt="<<r.dt<<" nu="<<r.nu<<endl;
+			return 1;
+		}
+		xprec.resize(taille);
+		for(int i=0;i<taille;i++){//le point de reprise est dans la numerotation du maillage lu
+			xprec[i]=r.xprec[perm.empty() ? i : perm[i]];
+		}
+		debut=r.pas+1;
+		cout<<"reprise apres le pas "<<r.pas<<endl;
+	}
+	else{
+		CHRONO("stokes");
+		X=resolution_Stokes(Th,0,nu,M1,n,xprec,0,0); //RESOLUTION STOKES
+		Memoire::declarer("matmap/stokes",OctetsMap(M1));
+		if(champs)
+			ecrivain.soumettre("plot/solution.bin",X.data(),0,0.);
+		xprec=X;
+	}
+	r.empreinte=empreinte; r.dt=dt; r.nu=nu; r.n=n;
+	if(!reprise && periodeReprise>0){
+		r.pas=-1; r.xprec.resize(taille);
+		PermuterDdl(perm,xprec.data(),r.xprec.data(),taille);
+		EcrireReprise(fichierReprise,r);
 	}
-	file1.close();
 
-	for(int t=1;t<80;t++){
-		string s = "plot/sol_"+to_string(t)+".txt";
-		ofstream file2(s.c_str());
-		cout<<"pas de temps"<<t<<endl;
+	SortieXdmf * sortieXdmf=0;
+	if(xdmf)
+		sortieXdmf=new SortieXdmf(debut>0 ? "plot/NS_"+to_string(debut) : "plot/NS",Th,n,compression);
 
-		X=resolution_Stokes(Th,alpha,nu,M2,n,xprec,1,1); ////RESOLUTION NAVIER-STOKES EN REUTILISANT LA MAP
-		xprec=X;
-		
-		for(int k=0;k<Th.nbt;k++){
-			for(int il=0;il<15;il++){
-				if(il<6){
-					i=Th(k,il);
-					file2<<xprec[i]<<" ";
-				}
-				else if(il<12){
-					i=Th(k,il-6);
-					file2<<xprec[i+n]<<" ";
-				}
-				else{
-					i=Th(k,il-12);
-					file2<<xprec[i+2*n]<<" ";
-				}
+	AnalyseInSitu * insitu=0;
+	if(analyse)
+		insitu=new AnalyseInSitu(Th,sondes,debut>0 ? ("plot/analyse_"+to_string(debut)+".csv").c_str() : "plot/analyse.csv");
+
+	bool MapExiste=false; //la map est construite au premier pas puis reutilisee
+	EspaceNS espace; //factorisation et tableaux de travail gardes d'un pas a l'autre
+	string s; //nom du snapshot, capacite reutilisee d'un pas a l'autre
+	long allocationsChronos=0; //pas apres le premier, chronometrage actif
+	for(int t=debut;t<nbPas;t++){
+		//mode test (make ALLOCS=1): le pas entier ne doit rien allouer apres le premier, sauf la
+		//sortie XDMF (allocations internes de HDF5, decomptees) et le chronometrage (signale)
+		long allocations=Memoire::allocations();
+		s.assign("plot/sol_");
+		s+=to_string(t);
+		s+=".bin";
+		cout<<"pas de temps "<<t<<endl;
+		ChronoPortee chronoPas("pas");
+
+		ResoudreNS(Th,alpha,nu,M2,n,xprec,1,MapExiste,1.,0,espace); ////RESOLUTION NAVIER-STOKES
+		xprec.swap(espace.x); //l'ancien xprec sert de tampon pour la solution suivante
+		bool premier=!MapExiste;
+		if(!MapExiste)
+			Memoire::declarer("matmap/ns",OctetsMap(M2));
+		MapExiste=true;
+		if(champs)
+			ecrivain.soumettre(s,xprec.data(),t,(t+1)*dt);
+		if(insitu){
+			CHRONO("analyse");
+			insitu->analyser(xprec.data(),t,(t+1)*dt);
+		}
+		if(sortieXdmf){
+			CHRONO("sortie");
+			long a=Memoire::allocations();
+			sortieXdmf->ecrire(xprec.data(),t,(t+1)*dt);
+			allocations+=Memoire::allocations()-a;
+		}
+		if(periodeReprise>0 && ((t+1)%periodeReprise==0 || t==nbPas-1)){
+			CHRONO("reprise");
+			r.pas=t; r.xprec.resize(taille);
+			PermuterDdl(perm,xprec.data(),r.xprec.data(),taille);
+			EcrireReprise(fichierReprise,r);
+		}
+		chronoPas.arreter();
+		Chronometrage::finPas(t);
+		allocations=Memoire::allocations()-allocations;
+		if(!premier && allocations>0){
+			if(Chronometrage::actif())
+				allocationsChronos+=allocations;
+			else{
+				cout<<"erreur: "<<allocations<<" allocations au pas "<<t<<endl;
+				return 1;
 			}
-		
-			file2<<"\n";
 		}
-		file2.close();
 	}
+	if(allocationsChronos>0)
+		cout<<"allocations apres le premier pas: "<<allocationsChronos<<" (chronometrage actif, non verifie)"<<endl;
+	delete sortieXdmf;
+	delete insitu;
+	ecrivain.terminer();
+	if(ecrivain.attentes()>0)
+		cout<<"ecriture: le solveur a attendu le disque "<<ecrivain.attentes()<<" fois"<<endl;
+	if(fichierChronos)
+		Chronometrage::ecrireResume(fichierChronos);
+	if(fichierTrace)
+		Chronometrage::ecrireTrace(fichierTrace);
+	if(fichierUmfpack)
+		statsUmfpack.ecrire(fichierUmfpack,configUmfpack);
+	if(fichierMemoire)
+		Memoire::ecrire(fichierMemoire);
+	if(!ecrivain.ok())
+		return 1;
 	return 0;
 }
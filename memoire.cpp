@@ -0,0 +1,94 @@
+#include "memoire.hpp"
+#include "chronos.hpp"
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <algorithm>
+#include <sys/resource.h>
+
+using namespace std;
+
+bool Memoire::actif_=false;
+
+#ifdef NS_COMPTE_ALLOCS
+//glibc: les points d'entree internes restent accessibles, malloc du programme les enveloppe
+extern "C" {
+	void * __libc_malloc(size_t taille);
+	void * __libc_calloc(size_t nb, size_t taille);
+	void * __libc_realloc(void * p, size_t taille);
+}
+static __thread long nbAllocations=0; //TLS statique: pas d'allocation au premier acces
+extern "C" void * malloc(size_t taille){
+	nbAllocations++;
+	return __libc_malloc(taille);
+}
+extern "C" void * calloc(size_t nb, size_t taille){
+	nbAllocations++;
+	return __libc_calloc(nb,taille);
+}
+extern "C" void * realloc(void * p, size_t taille){
+	nbAllocations++;
+	return __libc_realloc(p,taille);
+}
+long Memoire::allocations(){
+	return nbAllocations;
+}
+#else
+long Memoire::allocations(){
+	return -1;
+}
+#endif
+
+namespace {
+	struct Compte {
+		double courant, pic;
+	};
+	mutex verrou;
+	map<string,Compte> comptes;
+	double totalCourant=0, totalPic=0;
+}
+
+void Memoire::declarer(const string & sousSysteme, double octets){
+	if(!actif_)
+		return;
+	lock_guard<mutex> l(verrou);
+	Compte & c=comptes[sousSysteme];
+	totalCourant+=octets-c.courant;
+	totalPic=max(totalPic,totalCourant);
+	c.courant=octets;
+	c.pic=max(c.pic,octets);
+}
+
+bool Memoire::ecrire(const char * fichier){
+	lock_guard<mutex> l(verrou);
+	ofstream f(fichier);
+	f<<"{\"sous_systemes\":{";
+	for(map<string,Compte>::iterator it=comptes.begin(); it!=comptes.end(); ++it){
+		f<<(it==comptes.begin() ? "\n" : ",\n")<<"\""<<it->first<<"\":{\"octets\":"<<it->second.courant<<",\"pic_octets\":"<<it->second.pic<<"}";
+	}
+	struct rusage ru; //ru_maxrss suit VmHWM, remis a zero par les phases chronometrees
+	getrusage(RUSAGE_SELF,&ru);
+	f<<"},\n\"declare_octets\":"<<totalCourant<<",\"declare_pic_octets\":"<<totalPic<<",\"rss_pic_ko\":"<<max((long)ru.ru_maxrss,Chronometrage::picProcessusKo());
+	map<string,ResumePhase> phases=Chronometrage::totaux();
+	f<<",\n\"phases_pic_ko\":{";
+	bool premier=true;
+	for(map<string,ResumePhase>::iterator it=phases.begin(); it!=phases.end(); ++it){
+		if(it->second.picKo<=0 || !it->second.picFiable)
+			continue;
+		f<<(premier ? "\n" : ",\n")<<"\""<<it->first<<"\":"<<it->second.picKo;
+		premier=false;
+	}
+	f<<"},\n\"phases_pic_non_fiables\":[";
+	premier=true;
+	for(map<string,ResumePhase>::iterator it=phases.begin(); it!=phases.end(); ++it){
+		if(it->second.picKo<=0 || it->second.picFiable)
+			continue;
+		f<<(premier ? "" : ",")<<"\""<<it->first<<"\"";
+		premier=false;
+	}
+	f<<"]}\n";
+	if(!f)
+		cout<<"erreur: ecriture de "<<fichier<<endl;
+	return (bool)f;
+}
@@ -0,0 +1,25 @@
+#ifndef MEMOIRE_HPP
+#define MEMOIRE_HPP
+
+//////////////////////////////////////// Comptabilite memoire /////////////////////////
+// Octets par sous-systeme (maillage, matrices, facteurs UMFPACK, ...), declares
+// explicitement par les structures: la valeur courante remplace la precedente, le pic
+// est conserve. Le rapport JSON ajoute le pic de RSS du processus et, si le
+// chronometrage memoire est actif, le pic de RSS de chaque phase.
+// Inactif (un test de booleen) si non active.
+// Mode test (make ALLOCS=1, -DNS_COMPTE_ALLOCS): malloc/calloc/realloc sont interceptes et
+// comptes par thread, ce qui permet de verifier qu'un pas de temps n'alloue rien.
+
+#include <string>
+
+class Memoire {
+public:
+	static void activer() {actif_=true;}
+	static bool actif() {return actif_;}
+	static void declarer(const std::string & sousSysteme, double octets);
+	static bool ecrire(const char * fichier);
+	static long allocations(); //allocations du thread courant depuis son debut, -1 hors mode test
+private:
+	static bool actif_;
+};
+#endif
@@ -9,6 +9,7 @@ Mesh2d::Mesh2d(const char * filename)
 {
   std::ifstream  f(filename); 
   assert( f); 
+	nt=0;ne=0; //numerotation locale a ce maillage (plusieurs maillages par programme)
   double coord[3] ; 
 	int inu;
 	int ind;
@@ -69,6 +70,31 @@ Triangle Mesh2d::operator[](int k)const{
 	return (this->t[k]);
 }
 
+uint64_t Mesh2d::empreinte(){//ne depend que du maillage lu (pas des points milieux)
+	uint64_t h=14695981039346656037ULL;
+	const uint64_t prime=1099511628211ULL;
+	int entetes[3]={nv,nbt,nbe};
+	const unsigned char * o=(const unsigned char *)entetes;
+	for(unsigned int i=0;i<sizeof(entetes);i++){
+		h=(h^o[i])*prime;
+	}
+	for(int i=0;i<nv;i++){
+		double c[2]={v[i].x,v[i].y};
+		o=(const unsigned char *)c;
+		for(unsigned int j=0;j<sizeof(c);j++){
+			h=(h^o[j])*prime;
+		}
+	}
+	for(int k=0;k<nbt;k++){
+		int s[3]={t[k].v[0].getNum(),t[k].v[1].getNum(),t[k].v[2].getNum()};
+		o=(const unsigned char *)s;
+		for(unsigned int j=0;j<sizeof(s);j++){
+			h=(h^o[j])*prime;
+		}
+	}
+	return h;
+}
+
 int Mesh2d::PointsMil(){//num des pts milieux
 
 	map< pair<int,int>,int> ME; //s1,s2,label (edge)
@@ -145,7 +171,244 @@ int Mesh2d::PointsMil(){//num des pts milieux
 		cout<<endl;
 	}*/
 	//cout<<"nb de triangles au bord"<<triangleSortie.size()<<endl;
+	CalculerGeometrie();
+	NumeroterDdl(DDL_BLOCS);
+	return n;
+}
+
+void Mesh2d::NumeroterDdl(int disposition){
+	NumerotationDdl & D=ddl;
+	D.disposition=disposition;
+	D.n=v.size();
+	D.nv=nv;
+	D.glob.resize(15*nbt);
+	for(int k=0;k<nbt;k++){
+		int * g=D.glob.data()+15*k;
+		for(int i=0;i<6;i++){
+			int noeud=(i<3) ? t[k].v[i].getNum() : t[k].mil[i-3].getNum();
+			g[i]=D.u1(noeud);
+			g[i+6]=D.u2(noeud);
+			if(i<3)
+				g[i+12]=D.p(noeud);
+		}
+	}
+}
+
+void Mesh2d::CalculerGeometrie(){
+	R2 PtsRef[7];
+	double Poids[7];
+	Quadrature7(PtsRef,Poids);
+	GeometrieTriangles & G=geo;
+	G.x0.resize(nbt); G.y0.resize(nbt); G.detJ.resize(nbt);
+	G.inv00.resize(nbt); G.inv01.resize(nbt); G.inv10.resize(nbt); G.inv11.resize(nbt);
+	G.qx.resize(7*nbt); G.qy.resize(7*nbt);
+	for(int k=0;k<nbt;k++){
+		double v0x=t[k].v[0].getX(), v0y=t[k].v[0].getY();
+		double v1x=t[k].v[1].getX(), v1y=t[k].v[1].getY();
+		double v2x=t[k].v[2].getX(), v2y=t[k].v[2].getY();
+		double d=(v1x-v0x)*(v2y-v0y)-(v1y-v0y)*(v2x-v0x);
+		G.x0[k]=v0x;
+		G.y0[k]=v0y;
+		G.detJ[k]=d;
+		G.inv00[k]=(v2y-v0y)/d;
+		G.inv01[k]=(v0x-v2x)/d;
+		G.inv10[k]=(v0y-v1y)/d;
+		G.inv11[k]=(v1x-v0x)/d;
+		for(int q=0;q<7;q++){
+			double l1=PtsRef[q].x, l2=PtsRef[q].y, l0=1-l1-l2;
+			G.qx[7*k+q]=l0*v0x+l1*v1x+l2*v2x;
+			G.qy[7*k+q]=l0*v0y+l1*v1y+l2*v2y;
+		}
+	}
+}
+
+
+
+//Raffinement uniforme: chaque triangle est coupe en 4 par ses points milieux (PointsMil doit avoir ete appele).
+//Les sommets du maillage raffine sont les noeuds P2 (meme numerotation), les aretes du bord sont coupees en 2.
+int Mesh2d::EcrireRaffine(const char * fichier){
+	int n=v.size();
+	map< pair<int,int>,int> Mil;
+	for(int k=0;k<nbt;k++){
+		for(int a=0;a<3;a++){
+			int s1=t[k].v[(a+1)%3].getNum();
+			int s2=t[k].v[(a+2)%3].getNum();
+			if(s2>s1)
+				swap(s1,s2);
+			Mil[make_pair(s1,s2)]=t[k].mil[a].getNum();
+		}
+	}
+	ofstream f(fichier);
+	if(!f){
+		cout<<"erreur: impossible d'ecrire "<<fichier<<endl;
+		return -1;
+	}
+	f.precision(17);
+	f<<n<<" "<<4*nbt<<" "<<2*nbe<<"\n";
+	for(int i=0;i<n;i++){
+		f<<v[i].getX()<<" "<<v[i].getY()<<" "<<v[i].getLab().OnGamma()<<"\n";
+	}
+	for(int k=0;k<nbt;k++){//sommets a, milieux m[a] opposes a a (numerotation 1..n du format)
+		int s[3],m[3];
+		for(int a=0;a<3;a++){
+			s[a]=t[k].v[a].getNum()+1;
+			m[a]=t[k].mil[a].getNum()+1;
+		}
+		f<<s[0]<<" "<<m[2]<<" "<<m[1]<<" 0\n";
+		f<<m[2]<<" "<<s[1]<<" "<<m[0]<<" 0\n";
+		f<<m[1]<<" "<<m[0]<<" "<<s[2]<<" 0\n";
+		f<<m[0]<<" "<<m[1]<<" "<<m[2]<<" 0\n";
+	}
+	for(int i=0;i<nbe;i++){
+		int s1=e[i].v[0].getNum(), s2=e[i].v[1].getNum();
+		int m=Mil[make_pair(max(s1,s2),min(s1,s2))];
+		f<<s1+1<<" "<<m+1<<" "<<e[i].lab.lab<<"\n";
+		f<<m+1<<" "<<s2+1<<" "<<e[i].lab.lab<<"\n";
+	}
 	return n;
 }
 
+//indice de (x,y) sur la courbe de Hilbert d'une grille 2^bits x 2^bits
+static uint64_t IndiceHilbert(uint32_t x, uint32_t y, int bits){
+	uint32_t n=1u<<bits;
+	uint64_t d=0;
+	for(uint32_t s=n/2;s>0;s/=2){
+		uint32_t rx=(x&s)>0, ry=(y&s)>0;
+		d+=(uint64_t)s*s*((3*rx)^ry);
+		if(ry==0){//rotation du quadrant
+			if(rx==1){
+				x=n-1-x;
+				y=n-1-y;
+			}
+			swap(x,y);
+		}
+	}
+	return d;
+}
+
+//entrelacement des bits de x et y (ordre Z)
+static uint64_t IndiceMorton(uint32_t x, uint32_t y, int bits){
+	uint64_t d=0;
+	for(int b=0;b<bits;b++){
+		d|=(uint64_t)((x>>b)&1)<<(2*b) | (uint64_t)((y>>b)&1)<<(2*b+1);
+	}
+	return d;
+}
+
+//Renumerote sommets et triangles dans l'ordre de la courbe (sommets: coordonnees, triangles:
+//barycentre) pour que les triangles voisins et leurs sommets soient proches en memoire dans
+//l'assemblage, la localisation des pieds de caracteristiques et l'interpolation. L'ordre local
+//des sommets de chaque triangle et l'ordre des aretes du bord sont conserves, ce qui permet de
+//retrouver la numerotation d'origine (NoeudsOriginaux).
+void Mesh2d::Reordonner(int courbe){
+	if(courbe==COURBE_AUCUNE || nv==0)
+		return;
+	assert((int)v.size()==nv); //avant PointsMil
+	const int bits=16;
+	double xmin=v[0].getX(), xmax=xmin, ymin=v[0].getY(), ymax=ymin;
+	for(int i=1;i<nv;i++){
+		xmin=min(xmin,v[i].getX()); xmax=max(xmax,v[i].getX());
+		ymin=min(ymin,v[i].getY()); ymax=max(ymax,v[i].getY());
+	}
+	double echelle=((1u<<bits)-1)/max(max(xmax-xmin,ymax-ymin),1e-300);
+	vector< pair<uint64_t,int> > cles(max(nv,nbt));
+	for(int i=0;i<nv;i++){
+		uint32_t x=(v[i].getX()-xmin)*echelle, y=(v[i].getY()-ymin)*echelle;
+		cles[i]=make_pair(courbe==COURBE_HILBERT ? IndiceHilbert(x,y,bits) : IndiceMorton(x,y,bits),i);
+	}
+	sort(cles.begin(),cles.begin()+nv);
+	sommetOriginal.resize(nv);
+	vector<int> rang(nv);
+	vector<Vertex> v2(nv);
+	for(int i=0;i<nv;i++){
+		int o=cles[i].second;
+		sommetOriginal[i]=o;
+		rang[o]=i;
+		double c[2]={v[o].getX(),v[o].getY()};
+		v2[i].build(c,i,v[o].getLab());
+	}
+	for(int k=0;k<nbt;k++){
+		double x=0, y=0;
+		for(int a=0;a<3;a++){
+			x+=v[t[k].v[a].getNum()].getX()/3;
+			y+=v[t[k].v[a].getNum()].getY()/3;
+		}
+		uint32_t ix=(x-xmin)*echelle, iy=(y-ymin)*echelle;
+		cles[k]=make_pair(courbe==COURBE_HILBERT ? IndiceHilbert(ix,iy,bits) : IndiceMorton(ix,iy,bits),k);
+	}
+	sort(cles.begin(),cles.begin()+nbt);
+	triangleOriginal.resize(nbt);
+	vector<Triangle> t2(nbt);
+	for(int k=0;k<nbt;k++){
+		const Triangle & K=t[cles[k].second];
+		triangleOriginal[k]=cles[k].second;
+		t2[k].numTri=k;
+		t2[k].area=K.area;
+		for(int a=0;a<3;a++){
+			t2[k].v[a]=v2[rang[K.v[a].getNum()]];
+		}
+	}
+	for(int k=0;k<nbt;k++){
+		for(int a=0;a<3;a++){
+			v2[t2[k].v[a].getNum()].ajoutTri(k);
+		}
+	}
+	for(int i=0;i<nbe;i++){
+		for(int a=0;a<2;a++){
+			e[i].v[a]=v2[rang[e[i].v[a].getNum()]];
+		}
+	}
+	v.swap(v2);
+	t.swap(t2);
+}
+
+vector<int> Mesh2d::NoeudsOriginaux() const{
+	vector<int> orig;
+	if(sommetOriginal.empty())
+		return orig;
+	orig.assign(v.size(),-1);
+	for(int i=0;i<nv;i++){
+		orig[i]=sommetOriginal[i];
+	}
+	vector<int> rangTri(nbt);
+	for(int k=0;k<nbt;k++){
+		rangTri[triangleOriginal[k]]=k;
+	}
+	int m=nv;
+	for(int ko=0;ko<nbt;ko++){//milieux dans l'ordre ou PointsMil les decouvre sur le maillage lu
+		const Triangle & K=t[rangTri[ko]];
+		for(int a=0;a<3;a++){
+			if(orig[K.mil[a].getNum()]<0)
+				orig[K.mil[a].getNum()]=m++;
+		}
+	}
+	return orig;
+}
 
+//chaque Triangle et Edge garde des copies de ses Vertex, avec leur liste de triangles
+OctetsMaillage Mesh2d::octets() const{
+	OctetsMaillage o={0,0,0,0,0,0,0};
+	o.sommets=(v.capacity()-v.size())*sizeof(Vertex);
+	for(unsigned int i=0;i<v.size();i++){
+		o.sommets+=v[i].octets();
+	}
+	o.triangles=(t.capacity()-t.size())*sizeof(Triangle);
+	for(unsigned int k=0;k<t.size();k++){
+		o.triangles+=sizeof(Triangle)-6*sizeof(Vertex);
+		for(int i=0;i<3;i++){
+			o.triangles+=t[k].v[i].octets()+t[k].mil[i].octets();
+		}
+	}
+	o.aretes=(e.capacity()-e.size())*sizeof(Edge);
+	for(unsigned int i=0;i<e.size();i++){
+		o.aretes+=sizeof(Edge)-2*sizeof(Vertex)+e[i].v[0].octets()+e[i].v[1].octets();
+	}
+	o.voisins=voisins.capacity()*sizeof(vector<int>);
+	for(unsigned int k=0;k<voisins.size();k++){
+		o.voisins+=voisins[k].capacity()*sizeof(int);
+	}
+	o.geometrie=geo.octets();
+	o.ddl=ddl.octets();
+	o.autres=sizeof(Mesh2d)+(triangleSortie.capacity()+sommetOriginal.capacity()+triangleOriginal.capacity())*sizeof(int);
+	return o;
+}
@@ -1,3 +1,5 @@
+#ifndef MESH_HPP
+#define MESH_HPP
 #include "R2.hpp"
 #include <cassert>
 #include <fstream>
@@ -5,6 +7,8 @@
 #include <math.h>
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <stdint.h>
 
 using namespace std;
 
@@ -31,16 +35,17 @@ class Vertex :public R2,public  Label
 	}
 	void setX(double xx){x=xx;}
 	void setY(double yy){y=yy;}
-	double getX(){return x;}
-	double getY(){return y;}
+	double getX() const {return x;}
+	double getY() const {return y;}
 	void setNum(int ng){NumGlobal_=ng;}
 	void setLab(Label l){lab=l.lab;}
-	Label getLab(){return lab;}
-	int getNum(){return NumGlobal_;}
+	Label getLab() const {return lab;}
+	int getNum() const {return NumGlobal_;}
 	void ajoutTri(int k){
 		tri.push_back(k);
 	}
 	vector<int> getTri(){return tri;}
+	size_t octets() const {return sizeof(Vertex)+tri.capacity()*sizeof(int);} //tas compris
 private:
 	int NumGlobal_;
 	vector<int> tri;
@@ -62,11 +67,7 @@ class Triangle {
 			v[0]=vtot[I[0]+offset];
 			v[1]=vtot[I[1]+offset];
 			v[2]=vtot[I[2]+offset];
-			double a=v[0].getm(v[1]);
-			double b=v[1].getm(v[2]);
-			double c=v[2].getm(v[0]);
-			double p=(a+b+c)/2; //semi-perimetre
-			area=sqrt(p*(p-a)*(p-b)*(p-c));
+			area=fabs(det(v[0],v[1],v[2]))/2; //produit mixte (pas de formule de Heron)
 			return area;
 		}
 };
@@ -90,6 +91,66 @@ class Edge {//bord du domaine
 };
 
 
+//formule de quadrature a 7 points (exacte en degre 5) du triangle de reference
+inline void Quadrature7(R2 * PtsRef, double * Poids){
+	double a1=(6-sqrt(15))/21, a2=(9-sqrt(15)*2)/21, a3=(6+sqrt(15))/21, a4=(9+sqrt(15)*2)/21;
+	double w1=(155-sqrt(15))/1200, w2=(155+sqrt(15))/1200;
+	R2 p[7]={R2(1./3,1./3),R2(a1,a1),R2(a1,a4),R2(a4,a1),R2(a3,a3),R2(a3,a2),R2(a2,a3)};
+	double w[7]={0.225,w1,w1,w1,w2,w2,w2};
+	for(int q=0;q<7;q++){
+		PtsRef[q]=p[q];
+		Poids[q]=w[q];
+	}
+}
+
+//Facteurs geometriques des triangles en structure de tableaux, calcules une fois par maillage
+//(fin de PointsMil): F_k(xh)=(x0,y0)+B xh, detJ=det B (2*aire orientee), inv=B^-1 et
+//(qx,qy)=F_k(points de Quadrature7), 7 par triangle.
+struct GeometrieTriangles {
+	vector<double> x0, y0, detJ, inv00, inv01, inv10, inv11;
+	vector<double> qx, qy;
+	size_t octets() const {
+		return (x0.capacity()+y0.capacity()+detJ.capacity()+inv00.capacity()+inv01.capacity()
+			+inv10.capacity()+inv11.capacity()+qx.capacity()+qy.capacity())*sizeof(double);
+	}
+	double aire(int k) const {return 0.5*fabs(detJ[k]);}
+	//coordonnees de P dans le triangle de reference de k; vrai si P est dans k (a l'arrondi pres)
+	bool contient(int k, const R2 & P, R2 & ref) const {
+		double dx=P.x-x0[k], dy=P.y-y0[k];
+		ref.x=inv00[k]*dx+inv01[k]*dy;
+		ref.y=inv10[k]*dx+inv11[k]*dy;
+		return min(min(ref.x,ref.y),1-ref.x-ref.y)>=-1e-12;
+	}
+};
+
+//Dispositions des ddl globaux: DDL_BLOCS [u1 (n) | u2 (n) | p (nv)] ou DDL_ENTRELACE
+//[(u1,u2) par noeud (2n) | p (nv)]. La pression est en fin de vecteur dans les deux cas.
+enum {DDL_BLOCS, DDL_ENTRELACE};
+
+//Table locale -> globale des 15 ddl P2-P1 de chaque triangle (u1: 0..5, u2: 6..11, p: 12..14),
+//contigue (nbt x 15) et calculee une fois (Mesh2d::NumeroterDdl): une lecture par ddl dans les
+//boucles d'assemblage, de conditions aux limites, de caracteristiques et de sortie.
+struct NumerotationDdl {
+	int disposition, n, nv;
+	vector<int> glob;
+	NumerotationDdl() : disposition(DDL_BLOCS), n(0), nv(0) {}
+	const int * operator[](int k) const {return glob.data()+15*k;}
+	int u1(int i) const {return disposition==DDL_ENTRELACE ? 2*i : i;}   //ddl de u1 au noeud P2 i
+	int u2(int i) const {return disposition==DDL_ENTRELACE ? 2*i+1 : i+n;}
+	int p(int i) const {return 2*n+i;}                                     //ddl de p au sommet i
+	int taille() const {return 2*n+nv;}
+	size_t octets() const {return glob.capacity()*sizeof(int);}
+};
+
+//courbes de remplissage pour Mesh2d::Reordonner
+enum {COURBE_AUCUNE, COURBE_HILBERT, COURBE_MORTON};
+
+//occupation memoire (octets, tas compris) des tableaux de Mesh2d
+struct OctetsMaillage {
+	size_t sommets, triangles, aretes, voisins, geometrie, ddl, autres;
+	size_t total() const {return sommets+triangles+aretes+voisins+geometrie+ddl+autres;}
+};
+
 class Mesh2d 
 {
 public:
@@ -101,10 +162,21 @@ public:
   Mesh2d(const char *  filename);
   ~Mesh2d() {};
 	int PointsMil();
+	void Reordonner(int courbe); // avant PointsMil: sommets et triangles dans l'ordre d'une courbe de remplissage
+	vector<int> NoeudsOriginaux() const; // apres PointsMil: num de chaque noeud P2 sans Reordonner (vide si non reordonne)
+	int EcrireRaffine(const char * fichier); // maillage raffine uniformement (apres PointsMil)
 	int operator()(int k, int i); // num global du sommet/milieu i du triangle k
 	Triangle operator[](int k)const;
+	uint64_t empreinte(); // empreinte (FNV-1a) des sommets et triangles du maillage
+	OctetsMaillage octets() const;
 	vector<int> triangleSortie;
+	vector<int> sommetOriginal, triangleOriginal; // num dans le fichier lu (vides si non reordonne)
+	GeometrieTriangles geo; // rempli par PointsMil
+	void CalculerGeometrie();
+	NumerotationDdl ddl; // rempli par PointsMil (DDL_BLOCS)
+	void NumeroterDdl(int disposition); // apres PointsMil
 private:
   Mesh2d(const Mesh2d &);
   void operator=(const Mesh2d&);
 };
+#endif
@@ -0,0 +1,464 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//////////////////////////////////////// Multigrille geometrique (bloc vitesse) /////////////////////////
+// Preconditionneur de C = alpha M + nu K reduit aux noeuds libres (u1 et u2 entrelaces, comme dans
+// SchurVitesse) sur une hierarchie de maillages obtenue par raffinement uniforme (EcrireRaffine):
+// le triangle k du niveau l-1 donne les triangles 4k..4k+3 du niveau l, et les noeuds P2 du niveau
+// l-1 sont les sommets du niveau l. Les espaces P2 sont emboites: la prolongation P evalue les
+// fonctions de base du triangle parent aux noeuds fins (interpolation exacte), la restriction est
+// P^T et chaque niveau grossier assemble C sur son maillage (MatBlocsNS::Av).
+// V-cycle symetrique (un lissage avant et apres):
+//  chebyshev: polynome de degre 2 en D^-1 C sur [0.1, 1.1] lambda_max, lambda_max estime par
+//             puissances iterees a la construction
+//  jacobi:    2 balayages de Jacobi amorti (2/3)
+// et resolution directe UMFPACK au niveau le plus grossier. Le V-cycle preconditionne un gradient
+// conjugue sur C (tolerance relative par composante) qui remplace la factorisation de C dans
+// SchurVitesse (-solveur schur -multigrille L). Avec -multigrille amg, la hierarchie est construite
+// a partir de C seul par agregation lissee (amg.hpp); le V-cycle est le meme.
+// (necessite Dirichlet, SymboliqueRenumerotee, configUmfpack et statsUmfpack de MatNS.hpp)
+
+enum {LISSEUR_CHEBYSHEV, LISSEUR_JACOBI};
+
+struct ConfigMultigrille {
+	int niveaux;   //raffinements du maillage lu (0: pas de multigrille geometrique)
+	bool algebrique; //-multigrille amg (amg.hpp)
+	int lisseur;
+	double tol;    //gradient conjugue sur C
+	int iterMax;
+	vector< unique_ptr<Mesh2d> > grossiers; //niveaux 0..niveaux-1; le plus fin est le maillage du calcul
+	ConfigMultigrille() : niveaux(0), algebrique(false), lisseur(LISSEUR_CHEBYSHEV), tol(1e-12), iterMax(200) {}
+	bool actif() const {return niveaux>0 || algebrique;}
+	//-multigrille L|amg, -lisseur chebyshev|jacobi; renvoie le nombre d'arguments consommes
+	int option(const string & opt, const char * valeur){
+		if(!valeur)
+			return 0;
+		string v(valeur);
+		if(opt=="-multigrille"){
+			algebrique=(v=="amg");
+			niveaux=algebrique ? 0 : max(0,atoi(valeur));
+			return 1;
+		}
+		if(opt=="-lisseur"){
+			if(v=="chebyshev")
+				lisseur=LISSEUR_CHEBYSHEV;
+			else if(v=="jacobi")
+				lisseur=LISSEUR_JACOBI;
+			else
+				cout<<"lisseur inconnu: "<<v<<endl;
+			return 1;
+		}
+		return 0;
+	}
+	//lit le maillage grossier, le raffine niveaux fois (plot/mg_<nom>_r<l>.msh) et garde les niveaux
+	//grossiers; renvoie le fichier du niveau le plus fin
+	string Hierarchie(const string & fichier){
+		grossiers.clear();
+		string racine=fichier.substr(fichier.find_last_of('/')+1);
+		racine=racine.substr(0,racine.rfind(".msh"));
+		string prec=fichier;
+		for(int l=0;l<niveaux;l++){
+			grossiers.push_back(unique_ptr<Mesh2d>(new Mesh2d(prec.c_str())));
+			grossiers.back()->PointsMil();
+			prec="plot/mg_"+racine+"_r"+to_string(l+1)+".msh";
+			grossiers.back()->EcrireRaffine(prec.c_str());
+		}
+		return prec;
+	}
+};
+ConfigMultigrille configMultigrille;
+
+struct NiveauMG {
+	int m;                       //noeuds libres
+	vector<Indice> Ap, Aj;       //C reduit (CSR scalaire, symetrique)
+	vector<double> Av, Dinv;
+	vector<Indice> Pp, Rp;       //prolongation depuis le niveau precedent (lignes: noeuds libres) et
+	vector<int> Pj, Rj;          //restriction P^T (lignes: noeuds du niveau precedent)
+	vector<double> Pv, Rv;
+	vector<double> b, x, r, d, q; //2m, entrelaces
+	double lambda;               //lambda_max(D^-1 C)
+	NiveauMG() : m(0), lambda(0) {}
+	size_t octets() const {
+		return (Ap.capacity()+Aj.capacity()+Pp.capacity()+Rp.capacity())*sizeof(Indice)+(Pj.capacity()+Rj.capacity())*sizeof(int)
+			+(Av.capacity()+Dinv.capacity()+Pv.capacity()+Rv.capacity()+b.capacity()+x.capacity()+r.capacity()+d.capacity()+q.capacity())*sizeof(double);
+	}
+};
+
+//transposee d'un CSR a nl lignes et nc colonnes
+template<class I>
+static void Transposer(int nl, int nc, const vector<Indice> & p, const vector<I> & j, const vector<double> & v, vector<Indice> & tp, vector<int> & tj, vector<double> & tv){
+	tp.assign(nc+1,0);
+	for(Indice q=0;q<p[nl];q++){
+		tp[j[q]+1]++;
+	}
+	for(int c=0;c<nc;c++){
+		tp[c+1]+=tp[c];
+	}
+	tj.resize(p[nl]);
+	tv.resize(p[nl]);
+	vector<Indice> pos(tp.begin(),tp.end()-1);
+	for(int i=0;i<nl;i++){
+		for(Indice q=p[i];q<p[i+1];q++){
+			tj[pos[j[q]]]=i;
+			tv[pos[j[q]]++]=v[q];
+		}
+	}
+}
+
+//noeuds libres de la vitesse (u1 et u2 sont imposees sur les memes noeuds)
+static void NoeudsLibres(Mesh2d & Th, vector<int> & reduit, vector<int> & libre){
+	Dirichlet cl;
+	ConstruireDirichlet(Th,cl);
+	int n=Th.v.size();
+	reduit.assign(n,-1);
+	libre.clear();
+	for(int a=0;a<n;a++){
+		if(cl.reduit[Th.ddl.u1(a)]>=0){
+			reduit[a]=libre.size();
+			libre.push_back(a);
+		}
+	}
+}
+
+class Multigrille {
+public:
+	Multigrille() : lisseur(LISSEUR_CHEBYSHEV), Numeric(0) {}
+	~Multigrille(){
+		if(Numeric)
+			UMF_FREE_NUMERIC(&Numeric);
+	}
+	bool vide() const {return niv.empty();}
+	int niveaux() const {return niv.size();}
+	size_t octets() const {
+		size_t o=(Wi.capacity())*sizeof(Indice)+(W.capacity()+bg.capacity()+xg.capacity()+rc.capacity()+zc.capacity()+dc.capacity()+qc.capacity())*sizeof(double);
+		for(unsigned int l=0;l<niv.size();l++){
+			o+=niv[l].octets();
+		}
+		return o;
+	}
+
+	//grossiers: niveaux 0..L-1 (configMultigrille), Th: niveau L (maillage du calcul) avec ses noeuds
+	//libres (reduit, libre) et C reduit (Cp, Ci, Cx) tel que factorise par SchurVitesse
+	void Construire(const vector< unique_ptr<Mesh2d> > & grossiers, const Mesh2d & Th, const vector<int> & reduit, const vector<int> & libre,
+		const vector<Indice> & Cp, const vector<Indice> & Ci, const vector<double> & Cx, double alpha, double nu, int lisseur_){
+		lisseur=lisseur_;
+		int L=grossiers.size();
+		niv.assign(L+1,NiveauMG());
+		vector< vector<int> > reduits(L+1);
+		for(int l=0;l<L;l++){
+			Mesh2d & G=*grossiers[l];
+			vector<int> lib;
+			NoeudsLibres(G,reduits[l],lib);
+			MatBlocsNS A;
+			A.Motif(G);
+			A.Assembler(G,alpha,nu);
+			NiveauMG & N=niv[l];
+			N.m=lib.size();
+			N.Ap.assign(1,0);
+			N.Aj.clear();
+			N.Av.clear();
+			for(int ra=0;ra<N.m;ra++){
+				int a=lib[ra];
+				for(Indice q=A.Ap[a];q<A.Ap[a+1];q++){
+					if(reduits[l][A.Aj[q]]>=0){
+						N.Aj.push_back(reduits[l][A.Aj[q]]);
+						N.Av.push_back(A.Av[q]);
+					}
+				}
+				N.Ap.push_back(N.Aj.size());
+			}
+		}
+		reduits[L]=reduit;
+		NiveauMG & F=niv[L];
+		F.m=libre.size();
+		F.Ap=Cp;
+		F.Aj=Ci;
+		F.Av=Cx;
+		for(int l=1;l<=L;l++){
+			Prolongation(*grossiers[l-1],l<L ? *grossiers[l] : Th,reduits[l-1],reduits[l],niv[l]);
+		}
+		Preparer();
+	}
+
+	//multigrille algebrique a partir de C reduit seul (amg.hpp)
+	void ConstruireAlgebrique(const vector<Indice> & Cp, const vector<Indice> & Ci, const vector<double> & Cx, int lisseur_);
+
+	//v <- C^-1 v (2m, entrelace) par gradient conjugue preconditionne par un V-cycle; renvoie le
+	//nombre d'iterations (tol: ||r_c|| <= tol ||v_c|| pour chaque composante c)
+	int Resoudre2(double * v, double tol, int iterMax){
+		NiveauMG & F=niv.back();
+		int m2=2*F.m;
+		double nb[2]={0,0}, rr[2], rho[2]={0,0};
+		for(int i=0;i<m2;i++){
+			rc[i]=v[i];
+			nb[i&1]+=v[i]*v[i];
+			v[i]=0;
+		}
+		rr[0]=nb[0]; rr[1]=nb[1];
+		Preconditionner();
+		for(int i=0;i<m2;i++){
+			dc[i]=zc[i];
+			rho[i&1]+=rc[i]*zc[i];
+		}
+		int it=0;
+		while((rr[0]>tol*tol*nb[0] || rr[1]>tol*tol*nb[1]) && it<iterMax){
+			Produit(F,dc.data(),qc.data());
+			double dq[2]={0,0}, a[2];
+			for(int i=0;i<m2;i++){
+				dq[i&1]+=dc[i]*qc[i];
+			}
+			for(int c=0;c<2;c++){
+				a[c]=dq[c]>0 ? rho[c]/dq[c] : 0.;
+				rr[c]=0;
+			}
+			for(int i=0;i<m2;i++){
+				v[i]+=a[i&1]*dc[i];
+				rc[i]-=a[i&1]*qc[i];
+				rr[i&1]+=rc[i]*rc[i];
+			}
+			Preconditionner();
+			double rho1[2]={0,0}, beta[2];
+			for(int i=0;i<m2;i++){
+				rho1[i&1]+=rc[i]*zc[i];
+			}
+			for(int c=0;c<2;c++){
+				beta[c]=rho[c]>0 ? rho1[c]/rho[c] : 0.;
+				rho[c]=rho1[c];
+			}
+			for(int i=0;i<m2;i++){
+				dc[i]=zc[i]+beta[i&1]*dc[i];
+			}
+			it++;
+		}
+		return it;
+	}
+
+private:
+	vector<NiveauMG> niv; //0: le plus grossier
+	int lisseur;
+	void * Numeric;       //C du niveau 0
+	vector<Indice> Wi;
+	vector<double> W, bg, xg;
+	vector<double> rc, zc, dc, qc; //gradient conjugue au niveau fin
+	Multigrille(const Multigrille &);
+	void operator=(const Multigrille &);
+
+	//diagonales, lambda_max, restrictions P^T, tableaux de travail et factorisation du niveau 0
+	void Preparer(){
+		for(unsigned int l=0;l<niv.size();l++){
+			NiveauMG & N=niv[l];
+			Diagonale(N);
+			N.b.assign(2*N.m,0.); N.x.assign(2*N.m,0.); N.r.assign(2*N.m,0.); N.d.assign(2*N.m,0.); N.q.assign(2*N.m,0.);
+			if(l>0){
+				if(N.lambda==0) //deja estime par ConstruireAlgebrique
+					N.lambda=LambdaMax(N);
+				Transposer(N.m,niv[l-1].m,N.Pp,N.Pj,N.Pv,N.Rp,N.Rj,N.Rv);
+			}
+		}
+		//niveau 0: C factorise (symetrique: A et A^T confondus)
+		NiveauMG & N=niv[0];
+		if(Numeric)
+			UMF_FREE_NUMERIC(&Numeric);
+		double Info[UMFPACK_INFO];
+		void * Symbolic;
+		int status=SymboliqueRenumerotee(N.m,N.Ap.data(),N.Aj.data(),N.Av.data(),N.m,&Symbolic,Info);
+		statsUmfpack.symbolique(status,Info);
+		status=UMF_NUMERIC(N.Ap.data(),N.Aj.data(),N.Av.data(),Symbolic,&Numeric,configUmfpack.Control,Info);
+		statsUmfpack.numerique(status,Info);
+		UMF_FREE_SYMBOLIC(&Symbolic);
+		Wi.resize(N.m); W.resize(N.m); bg.resize(N.m); xg.resize(N.m);
+		int mf=niv.back().m;
+		rc.resize(2*mf); zc.resize(2*mf); dc.resize(2*mf); qc.resize(2*mf);
+	}
+
+	//P du niveau l-1 (Tc) au niveau l (Tf): ligne du noeud libre fin a = Phi_j(parent) en a
+	static void Prolongation(const Mesh2d & Tc, const Mesh2d & Tf, const vector<int> & reduitC, const vector<int> & reduitF, NiveauMG & N){
+		assert(Tf.nbt==4*Tc.nbt && Tf.nv==(int)Tc.v.size());
+		vector< vector< pair<int,double> > > lignes(N.m);
+		vector<char> fait(N.m,0);
+		int nc[6], nf[6];
+		for(int k=0;k<Tc.nbt;k++){
+			NoeudsTriangle(Tc,k,nc);
+			for(int e=4*k;e<4*k+4;e++){
+				NoeudsTriangle(Tf,e,nf);
+				for(int i=0;i<6;i++){
+					int ra=reduitF[nf[i]];
+					if(ra<0 || fait[ra])
+						continue;
+					fait[ra]=1;
+					R2 ref;
+					bool dedans=Tc.geo.contient(k,R2(Tf.v[nf[i]].getX(),Tf.v[nf[i]].getY()),ref);
+					assert(dedans);
+					(void)dedans;
+					for(int j=0;j<6;j++){
+						double w=Phi(j,ref);
+						if(reduitC[nc[j]]>=0 && fabs(w)>1e-12)
+							lignes[ra].push_back(make_pair(reduitC[nc[j]],w));
+					}
+				}
+			}
+		}
+		N.Pp.assign(1,0);
+		N.Pj.clear();
+		N.Pv.clear();
+		for(int ra=0;ra<N.m;ra++){
+			for(unsigned int q=0;q<lignes[ra].size();q++){
+				N.Pj.push_back(lignes[ra][q].first);
+				N.Pv.push_back(lignes[ra][q].second);
+			}
+			N.Pp.push_back(N.Pj.size());
+		}
+	}
+
+	static void Diagonale(NiveauMG & N){
+		N.Dinv.assign(N.m,0.);
+		for(int i=0;i<N.m;i++){
+			for(Indice q=N.Ap[i];q<N.Ap[i+1];q++){
+				if(N.Aj[q]==i)
+					N.Dinv[i]=1./N.Av[q];
+			}
+		}
+	}
+
+	//y = C x, x et y entrelaces
+	static void Produit(const NiveauMG & N, const double * x, double * y){
+		NS_OMP_POUR
+		for(int i=0;i<N.m;i++){
+			double y1=0, y2=0;
+			for(Indice q=N.Ap[i];q<N.Ap[i+1];q++){
+				y1+=N.Av[q]*x[2*N.Aj[q]];
+				y2+=N.Av[q]*x[2*N.Aj[q]+1];
+			}
+			y[2*i]=y1;
+			y[2*i+1]=y2;
+		}
+	}
+
+	//lambda_max(D^-1 C) par puissances iterees (premiere composante)
+	static double LambdaMax(NiveauMG & N){
+		for(int i=0;i<N.m;i++){
+			N.d[2*i]=1.+0.1*sin(i); //depart non orthogonal au vecteur propre dominant
+			N.d[2*i+1]=0.;
+		}
+		double l=0;
+		for(int it=0;it<15;it++){
+			Produit(N,N.d.data(),N.q.data());
+			double nq=0, nd=0;
+			for(int i=0;i<N.m;i++){
+				N.q[2*i]*=N.Dinv[i];
+				nq+=N.q[2*i]*N.q[2*i];
+				nd+=N.d[2*i]*N.d[2*i];
+			}
+			l=sqrt(nq/nd);
+			for(int i=0;i<N.m;i++){
+				N.d[2*i]=N.q[2*i]/sqrt(nq);
+			}
+		}
+		return l;
+	}
+
+	//x <- x + p(D^-1 C) D^-1 (b - C x); xNul: x=0 en entree (pas de produit C x)
+	void Lisser(NiveauMG & N, bool xNul){
+		int m2=2*N.m;
+		if(xNul)
+			fill(N.q.begin(),N.q.end(),0.);
+		if(lisseur==LISSEUR_JACOBI){
+			for(int s=0;s<2;s++){
+				if(s>0 || !xNul)
+					Produit(N,N.x.data(),N.q.data());
+				NS_OMP_POUR
+				for(int i=0;i<m2;i++){
+					N.x[i]+=(2./3)*N.Dinv[i/2]*(N.b[i]-N.q[i]);
+				}
+			}
+			return;
+		}
+		const int degre=2;
+		double lmax=1.1*N.lambda, lmin=0.1*N.lambda;
+		double theta=0.5*(lmax+lmin), delta=0.5*(lmax-lmin), sigma=theta/delta, rho=1./sigma;
+		if(!xNul)
+			Produit(N,N.x.data(),N.q.data());
+		NS_OMP_POUR
+		for(int i=0;i<m2;i++){
+			N.r[i]=N.Dinv[i/2]*(N.b[i]-N.q[i]);
+			N.d[i]=N.r[i]/theta;
+		}
+		for(int k=0;k<degre;k++){
+			NS_OMP_POUR
+			for(int i=0;i<m2;i++){
+				N.x[i]+=N.d[i];
+			}
+			if(k==degre-1)
+				break;
+			Produit(N,N.d.data(),N.q.data());
+			double rho1=1./(2*sigma-rho);
+			NS_OMP_POUR
+			for(int i=0;i<m2;i++){
+				N.r[i]-=N.Dinv[i/2]*N.q[i];
+				N.d[i]=rho1*rho*N.d[i]+2*rho1/delta*N.r[i];
+			}
+			rho=rho1;
+		}
+	}
+
+	//N.x ~ C^-1 N.b au niveau l
+	void Cycle(int l){
+		NiveauMG & N=niv[l];
+		if(l==0){
+			double Control[UMFPACK_CONTROL], Info[UMFPACK_INFO];
+			copy(configUmfpack.Control,configUmfpack.Control+UMFPACK_CONTROL,Control);
+			Control[UMFPACK_IRSTEP]=0; //W de taille m suffit sans raffinement
+			for(int c=0;c<2;c++){
+				for(int i=0;i<N.m;i++){
+					bg[i]=N.b[2*i+c];
+				}
+				UMF_WSOLVE(UMFPACK_A,N.Ap.data(),N.Aj.data(),N.Av.data(),xg.data(),bg.data(),Numeric,Control,Info,Wi.data(),W.data());
+				for(int i=0;i<N.m;i++){
+					N.x[2*i+c]=xg[i];
+				}
+			}
+			return;
+		}
+		int m2=2*N.m;
+		fill(N.x.begin(),N.x.end(),0.);
+		Lisser(N,true);
+		Produit(N,N.x.data(),N.q.data());
+		NS_OMP_POUR
+		for(int i=0;i<m2;i++){
+			N.r[i]=N.b[i]-N.q[i];
+		}
+		NiveauMG & G=niv[l-1];
+		NS_OMP_POUR
+		for(int i=0;i<G.m;i++){//restriction P^T
+			double b1=0, b2=0;
+			for(Indice q=N.Rp[i];q<N.Rp[i+1];q++){
+				b1+=N.Rv[q]*N.r[2*N.Rj[q]];
+				b2+=N.Rv[q]*N.r[2*N.Rj[q]+1];
+			}
+			G.b[2*i]=b1;
+			G.b[2*i+1]=b2;
+		}
+		Cycle(l-1);
+		NS_OMP_POUR
+		for(int i=0;i<N.m;i++){//correction P x_G
+			for(Indice q=N.Pp[i];q<N.Pp[i+1];q++){
+				N.x[2*i]+=N.Pv[q]*G.x[2*N.Pj[q]];
+				N.x[2*i+1]+=N.Pv[q]*G.x[2*N.Pj[q]+1];
+			}
+		}
+		Lisser(N,false);
+	}
+
+	//zc = V-cycle(rc)
+	void Preconditionner(){
+		NiveauMG & F=niv.back();
+		copy(rc.begin(),rc.end(),F.b.begin());
+		Cycle(niv.size()-1);
+		copy(F.x.begin(),F.x.end(),zc.begin());
+	}
+};
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <vector>
+#include "amd.h"
+#include "camd.h"
+#include "metis.h"
+
+using namespace std;
+
+//////////////////////////////////////// Renumerotation des ddl /////////////////////////
+// Ordonnancements reduisant le remplissage, calcules sur le graphe P2-P1 (motif de A+A^T) et
+// donnes a UMFPACK comme pre-ordonnancement des colonnes (umfpack_*_qsymbolic, voir
+// SymboliqueRenumerotee dans MatNS.hpp): c'est une renumerotation symetrique des inconnues du
+// systeme lineaire, la numerotation du maillage et des sorties est inchangee.
+//  amd:   degre minimum approche
+//  camd:  AMD contraint, pression numerotee apres la vitesse (point-selle)
+//  metis: dissection emboitee (METIS_NodeND)
+//  rcm:   Cuthill-McKee inverse (reduction de largeur de bande)
+//  auto:  compare les ordres ci-dessus et celui d'UMFPACK sur la matrice (remplissage, flops,
+//         temps de factorisation) et garde celui de plus petit nnz(L+U)
+// (necessite le type Indice de MatNS.hpp)
+
+enum Ordre {ORDRE_UMFPACK, ORDRE_AMD, ORDRE_CAMD, ORDRE_METIS, ORDRE_RCM, NB_ORDRES, ORDRE_AUTO=NB_ORDRES};
+static const char * nomsOrdres[NB_ORDRES+1]={"umfpack","amd","camd","metis","rcm","auto"};
+
+#ifdef NS_INDICES64
+#define AMD_ORDRE amd_l_order
+#define CAMD_ORDRE camd_l_order
+#else
+#define AMD_ORDRE amd_order
+#define CAMD_ORDRE camd_order
+#endif
+
+//motif de A+A^T sans la diagonale, lignes triees
+void GrapheSymetrique(int taille, const Indice * Ap, const Indice * AI, vector<Indice> & Gp, vector<Indice> & Gi){
+	vector<Indice> degre(taille,0);
+	for(int i=0;i<taille;i++){
+		for(Indice p=Ap[i];p<Ap[i+1];p++){
+			if(AI[p]!=i){
+				degre[i]++;
+				degre[AI[p]]++;
+			}
+		}
+	}
+	Gp.assign(taille+1,0);
+	for(int i=0;i<taille;i++){
+		Gp[i+1]=Gp[i]+degre[i];
+	}
+	Gi.resize(Gp[taille]);
+	vector<Indice> pos(Gp.begin(),Gp.end()-1);
+	for(int i=0;i<taille;i++){
+		for(Indice p=Ap[i];p<Ap[i+1];p++){
+			Indice j=AI[p];
+			if(j!=i){
+				Gi[pos[i]++]=j;
+				Gi[pos[j]++]=i;
+			}
+		}
+	}
+	Indice fin=0;
+	for(int i=0;i<taille;i++){//doublons (motif deja symetrique)
+		Indice debut=Gp[i];
+		sort(Gi.begin()+debut,Gi.begin()+Gp[i+1]);
+		Indice * f=unique(Gi.data()+debut,Gi.data()+Gp[i+1]);
+		Gp[i]=fin;
+		for(Indice * q=Gi.data()+debut;q<f;q++){
+			Gi[fin++]=*q;
+		}
+	}
+	Gp[taille]=fin;
+	Gi.resize(fin);
+}
+
+//Cuthill-McKee inverse, depart de chaque composante en un noeud pseudo-peripherique
+void OrdreRCM(int taille, const vector<Indice> & Gp, const vector<Indice> & Gi, vector<Indice> & perm){
+	perm.clear();
+	vector<char> vu(taille,0);
+	vector<Indice> niveau(taille,-1), file;
+	for(int s=0;s<taille;s++){
+		if(vu[s])
+			continue;
+		//noeud pseudo-peripherique: parcours en largeur repetes depuis le dernier noeud atteint
+		Indice depart=s;
+		int excentricite=-1;
+		for(int essai=0;essai<5;essai++){
+			file.assign(1,depart);
+			niveau[depart]=0;
+			for(size_t q=0;q<file.size();q++){
+				Indice i=file[q];
+				for(Indice p=Gp[i];p<Gp[i+1];p++){
+					if(niveau[Gi[p]]<0){
+						niveau[Gi[p]]=niveau[i]+1;
+						file.push_back(Gi[p]);
+					}
+				}
+			}
+			Indice dernier=file.back();
+			int e=niveau[dernier];
+			for(size_t q=0;q<file.size();q++){//degre minimal sur le dernier niveau
+				if(niveau[file[q]]==e && Gp[file[q]+1]-Gp[file[q]]<Gp[dernier+1]-Gp[dernier])
+					dernier=file[q];
+			}
+			for(size_t q=0;q<file.size();q++){
+				niveau[file[q]]=-1;
+			}
+			if(e<=excentricite)
+				break;
+			excentricite=e;
+			depart=dernier;
+		}
+		//Cuthill-McKee: voisins par degre croissant
+		size_t debut=perm.size();
+		perm.push_back(depart);
+		vu[depart]=1;
+		for(size_t q=debut;q<perm.size();q++){
+			Indice i=perm[q];
+			size_t premier=perm.size();
+			for(Indice p=Gp[i];p<Gp[i+1];p++){
+				if(!vu[Gi[p]]){
+					vu[Gi[p]]=1;
+					perm.push_back(Gi[p]);
+				}
+			}
+			sort(perm.begin()+premier,perm.end(),[&](Indice a, Indice b){
+				return Gp[a+1]-Gp[a]<Gp[b+1]-Gp[b];
+			});
+		}
+	}
+	reverse(perm.begin(),perm.end());
+}
+
+//perm[k] = ancien numero du ddl place en position k; false si l'ordre n'a pas pu etre calcule
+//(debutPression: premier ddl de pression, les ddl de pression sont en fin de systeme)
+bool CalculerOrdre(Ordre o, int taille, const Indice * Ap, const Indice * AI, int debutPression, vector<Indice> & perm){
+	perm.resize(taille);
+	if(o==ORDRE_AMD || o==ORDRE_CAMD){
+		double Info[CAMD_INFO];
+		if(o==ORDRE_AMD)
+			return AMD_ORDRE(taille,Ap,AI,perm.data(),NULL,Info)>=AMD_OK;
+		vector<Indice> C(taille,0); //contrainte: vitesse (ensemble 0) avant pression (ensemble 1)
+		for(int i=debutPression;i<taille;i++){
+			C[i]=1;
+		}
+		return CAMD_ORDRE(taille,Ap,AI,perm.data(),NULL,Info,C.data())>=CAMD_OK;
+	}
+	vector<Indice> Gp, Gi;
+	GrapheSymetrique(taille,Ap,AI,Gp,Gi);
+	if(o==ORDRE_RCM){
+		OrdreRCM(taille,Gp,Gi,perm);
+		return true;
+	}
+	if(o==ORDRE_METIS){
+		idx_t nv=taille;
+		vector<idx_t> xadj(Gp.begin(),Gp.end()), adjncy(Gi.begin(),Gi.end()), p(taille), ip(taille);
+		idx_t options[METIS_NOPTIONS];
+		METIS_SetDefaultOptions(options);
+		options[METIS_OPTION_NUMBERING]=0;
+		if(METIS_NodeND(&nv,xadj.data(),adjncy.data(),NULL,options,p.data(),ip.data())!=METIS_OK)
+			return false;
+		perm.assign(p.begin(),p.end());
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,100 @@
+#include "reprise.hpp"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+struct EnteteReprise {
+	char magic[8];
+	uint32_t version;
+	int32_t pas;
+	uint64_t empreinte;
+	double dt, nu;
+	int64_t n;
+	int64_t taille;
+	uint64_t controle; //FNV-1a des valeurs de xprec
+};
+
+static uint64_t SommeControle(const vector<double> & x){
+	uint64_t h=14695981039346656037ULL;
+	const unsigned char * o=(const unsigned char *)x.data();
+	for(size_t i=0;i<x.size()*sizeof(double);i++){
+		h=(h^o[i])*1099511628211ULL;
+	}
+	return h;
+}
+
+static bool EcrireTout(int fd, const void * p, size_t octets){
+	const char * c=(const char *)p;
+	while(octets>0){
+		ssize_t k=write(fd,c,octets);
+		if(k<=0)
+			return false;
+		c+=k;
+		octets-=k;
+	}
+	return true;
+}
+
+//E/S POSIX et nom temporaire reutilise: pas d'allocation apres le premier appel (make ALLOCS=1)
+bool EcrireReprise(const char * fichier, const PointReprise & r){
+	EnteteReprise e;
+	memset(&e,0,sizeof(e));
+	memcpy(e.magic,REPRISE_MAGIC,sizeof(e.magic));
+	e.version=REPRISE_VERSION;
+	e.pas=r.pas;
+	e.empreinte=r.empreinte;
+	e.dt=r.dt;
+	e.nu=r.nu;
+	e.n=r.n;
+	e.taille=r.xprec.size();
+	e.controle=SommeControle(r.xprec);
+
+	static thread_local string tmp;
+	tmp.assign(fichier);
+	tmp+=".tmp";
+	int fd=open(tmp.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0644);
+	if(fd<0){
+		cout<<"erreur: impossible d'ouvrir "<<tmp<<endl;
+		return false;
+	}
+	bool ok=EcrireTout(fd,&e,sizeof(e)) && EcrireTout(fd,r.xprec.data(),r.xprec.size()*sizeof(double)) && (fsync(fd)==0);
+	ok=(close(fd)==0) && ok;
+	if(ok)
+		ok=(rename(tmp.c_str(),fichier)==0);
+	if(!ok){
+		cout<<"erreur: point de reprise "<<fichier<<" non ecrit"<<endl;
+		remove(tmp.c_str());
+	}
+	return ok;
+}
+
+bool LireReprise(const char * fichier, PointReprise & r){
+	FILE * f=fopen(fichier,"rb");
+	if(f==NULL){
+		cout<<"erreur: impossible d'ouvrir "<<fichier<<endl;
+		return false;
+	}
+	EnteteReprise e;
+	bool ok=(fread(&e,sizeof(e),1,f)==1)
+		&& memcmp(e.magic,REPRISE_MAGIC,sizeof(e.magic))==0 && e.version==REPRISE_VERSION && e.taille>0;
+	if(ok){
+		r.xprec.resize(e.taille);
+		ok=(fread(r.xprec.data(),sizeof(double),e.taille,f)==(size_t)e.taille) && SommeControle(r.xprec)==e.controle;
+	}
+	fclose(f);
+	if(!ok){
+		cout<<"erreur: point de reprise "<<fichier<<" illisible ou corrompu"<<endl;
+		return false;
+	}
+	r.empreinte=e.empreinte;
+	r.pas=e.pas;
+	r.dt=e.dt;
+	r.nu=e.nu;
+	r.n=e.n;
+	return true;
+}
@@ -0,0 +1,27 @@
+#ifndef REPRISE_HPP
+#define REPRISE_HPP
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+//////////////////////////////////////// Points de reprise /////////////////////////
+// Etat minimal pour reprendre la boucle en temps: xprec, le dernier pas calcule, dt, nu
+// et l'empreinte du maillage. L'ecriture passe par un fichier temporaire puis rename():
+// un arret pendant l'ecriture laisse le point de reprise precedent intact.
+
+#define REPRISE_MAGIC "NSREPR1"
+#define REPRISE_VERSION 1
+
+struct PointReprise {
+	uint64_t empreinte;
+	int pas; //dernier pas calcule (-1: solution de Stokes seule)
+	double dt, nu;
+	int n;
+	vector<double> xprec;
+};
+
+bool EcrireReprise(const char * fichier, const PointReprise & r);
+//retourne false si le fichier est absent, tronque ou corrompu
+bool LireReprise(const char * fichier, PointReprise & r);
+#endif
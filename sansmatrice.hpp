@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+//////////////////////////////////////// Operateur P2-P1 sans matrice /////////////////////////
+// Applique le systeme de BuildMatNS triangle par triangle sans l'assembler:
+//  C = alpha M + nu K sur u1 et u2, gradient B (p -> lignes de vitesse), divergence B^T
+//  (u -> lignes de pression) et le terme -eps de la pression.
+// Les integrales sur le triangle de reference (Quadrature7) sont tabulees une fois (Initialiser);
+// par triangle on ne lit que detJ et B^-1 (Th.geo) et les 15 ddl (Th.ddl): ~100 octets par
+// triangle plus x et y, contre ~12 octets par non nul (pres de 60 non nuls par ligne de vitesse)
+// pour un CSR. Meme interface que MatBlocsNS et SpMV (Produit(x, y)), dans la disposition de
+// Th.ddl (blocs ou entrelace); les termes elementaires ne sont pas filtres (|a|<=1e-15) comme a
+// l'assemblage, le resultat differe du produit assemble a l'arrondi pres.
+
+//parties de l'operateur appliquees par OperateurNS::Appliquer
+enum {OP_VITESSE=1, OP_GRADIENT=2, OP_DIVERGENCE=4, OP_PRESSION=8, OP_TOUT=15};
+
+//-residu sansmatrice (a la suite des formats SpMV)
+enum {RESIDU_SANS_MATRICE=SPMV_SELL+1};
+
+struct OperateurNS {
+	const Mesh2d * Th;
+	double alpha, nu;
+	//triangle de reference: masse, derivees (x,x), (x,y)+(y,x), (y,y) en triangle superieur range
+	//par lignes (21 termes, la matrice elementaire est symetrique), derivees x lambda_c (6 x 3)
+	double M[21], Kxx[21], Kxy[21], Kyy[21], Gx[18], Gy[18];
+	OperateurNS() : Th(0), alpha(0), nu(0) {}
+	bool vide() const {return Th==0;}
+	int taille() const {return Th->ddl.taille();}
+	void Initialiser(const Mesh2d & Th_, double alpha_, double nu_);
+	//octets lus et ecrits par un produit (facteurs geometriques, table des ddl, x, y)
+	double octets() const {
+		return Th->nbt*(5.*sizeof(double)+15.*sizeof(int))+3.*taille()*sizeof(double);
+	}
+	void Produit(const double * x, double * y) const {Appliquer(x,y,OP_TOUT);}
+	//C sur u1 et u2 seulement (lignes de pression nulles)
+	void ProduitVitesse(const double * x, double * y) const {Appliquer(x,y,OP_VITESSE);}
+	void Appliquer(const double * x, double * y, int parties) const;
+};
+
+void OperateurNS::Initialiser(const Mesh2d & Th_, double alpha_, double nu_){
+	Th=&Th_;
+	alpha=alpha_;
+	nu=nu_;
+	R2 PtsRef[7];
+	double Poids[7];
+	Quadrature7(PtsRef,Poids);
+	int l=0;
+	for(int i=0;i<6;i++){
+		for(int j=i;j<6;j++,l++){
+			M[l]=Kxx[l]=Kxy[l]=Kyy[l]=0;
+			for(int q=0;q<7;q++){
+				R2 P=PtsRef[q];
+				M[l]+=Poids[q]*Phi(i,P)*Phi(j,P);
+				Kxx[l]+=Poids[q]*PartialPhi(i,0,P)*PartialPhi(j,0,P);
+				Kxy[l]+=Poids[q]*(PartialPhi(i,1,P)*PartialPhi(j,0,P)+PartialPhi(i,0,P)*PartialPhi(j,1,P));
+				Kyy[l]+=Poids[q]*PartialPhi(i,1,P)*PartialPhi(j,1,P);
+			}
+		}
+		for(int c=0;c<3;c++){
+			Gx[3*i+c]=Gy[3*i+c]=0;
+			for(int q=0;q<7;q++){
+				Gx[3*i+c]+=Poids[q]*PartialPhi(i,0,PtsRef[q])*lambda(c,PtsRef[q]);
+				Gy[3*i+c]+=Poids[q]*PartialPhi(i,1,PtsRef[q])*lambda(c,PtsRef[q]);
+			}
+		}
+	}
+}
+
+void OperateurNS::Appliquer(const double * x, double * y, int parties) const {
+	const GeometrieTriangles & G=Th->geo;
+	const NumerotationDdl & D=Th->ddl;
+	fill(y,y+taille(),0.);
+	for(int k=0;k<Th->nbt;k++){
+		const int * g=D[k];
+		double d=G.detJ[k], aire=0.5*fabs(d);
+		double J00=d*G.inv00[k], J01=d*G.inv10[k], J10=d*G.inv01[k], J11=d*G.inv11[k]; //detJ (B^-1)^T
+		double u1[6], u2[6], p[3], y1[6]={0,0,0,0,0,0}, y2[6]={0,0,0,0,0,0}, yp[3]={0,0,0};
+		for(int i=0;i<6;i++){
+			u1[i]=x[g[i]];
+			u2[i]=x[g[i+6]];
+		}
+		for(int c=0;c<3;c++){
+			p[c]=x[g[c+12]];
+		}
+		if(parties&OP_VITESSE){//memes coefficients que BuildMatNS
+			double cm=alpha*aire, ck=nu/(4*aire);
+			double a=ck*(J00*J00+J10*J10), b=ck*(J00*J01+J10*J11), c=ck*(J01*J01+J11*J11);
+			double C[21];
+			for(int l=0;l<21;l++){
+				C[l]=cm*M[l]+a*Kxx[l]+b*Kxy[l]+c*Kyy[l];
+			}
+			for(int i=0, l=0;i<6;i++){
+				y1[i]+=C[l]*u1[i];
+				y2[i]+=C[l]*u2[i];
+				l++;
+				for(int j=i+1;j<6;j++,l++){
+					double cij=C[l];
+					y1[i]+=cij*u1[j];
+					y2[i]+=cij*u2[j];
+					y1[j]+=cij*u1[i];
+					y2[j]+=cij*u2[i];
+				}
+			}
+		}
+		if(parties&(OP_GRADIENT|OP_DIVERGENCE)){
+			double B1[18], B2[18];
+			for(int l=0;l<18;l++){
+				B1[l]=-0.5*(J00*Gx[l]+J01*Gy[l]);
+				B2[l]=-0.5*(J10*Gx[l]+J11*Gy[l]);
+			}
+			for(int i=0;i<6;i++){
+				for(int c=0;c<3;c++){
+					if(parties&OP_GRADIENT){
+						y1[i]+=B1[3*i+c]*p[c];
+						y2[i]+=B2[3*i+c]*p[c];
+					}
+					if(parties&OP_DIVERGENCE)
+						yp[c]+=B1[3*i+c]*u1[i]+B2[3*i+c]*u2[i];
+				}
+			}
+		}
+		if(parties&OP_PRESSION){
+			for(int c=0;c<3;c++){
+				yp[c]-=(10e-8)*p[c];
+			}
+		}
+		for(int i=0;i<6;i++){
+			y[g[i]]+=y1[i];
+			y[g[i+6]]+=y2[i];
+		}
+		for(int c=0;c<3;c++){
+			y[g[c+12]]+=yp[c];
+		}
+	}
+}
@@ -0,0 +1,44 @@
+#include "mesh.hpp"
+#include "sortie.hpp"
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// Conversion des snapshots binaires (sol_<t>.bin) vers le format texte par triangle lu par plot/plot.edp
+// usage: snap2txt maillage.msh sol_0.bin [sol_1.bin ...]   -> sol_0.txt, sol_1.txt, ...
+int main(int argc, const char** argv)
+{
+	if(argc<3){
+		cout<<"usage: "<<argv[0]<<" maillage.msh fichier.bin [fichier.bin ...]"<<endl;
+		return 1;
+	}
+	Mesh2d Th(argv[1]);
+	uint64_t empreinte=Th.empreinte();
+	int n=Th.PointsMil();
+	int erreurs=0;
+
+	for(int a=2;a<argc;a++){
+		SnapshotLu s(argv[a]);
+		if(!s.ok()){
+			cout<<"erreur: "<<argv[a]<<" n'est pas un snapshot valide"<<endl;
+			erreurs++;
+			continue;
+		}
+		if(s.entete().empreinte!=empreinte || s.entete().n!=n || s.entete().taille!=2*n+Th.nv){
+			cout<<"erreur: "<<argv[a]<<" ne correspond pas au maillage "<<argv[1]<<endl;
+			erreurs++;
+			continue;
+		}
+		string nom(argv[a]);
+		size_t point=nom.rfind(".bin");
+		if(point!=string::npos)
+			nom.erase(point);
+		nom+=".txt";
+		ofstream f(nom.c_str());
+		EcrireSolutionTexte(Th,n,s,f);
+		cout<<argv[a]<<" -> "<<nom<<" (pas "<<s.entete().pas<<", t="<<s.entete().temps<<")"<<endl;
+	}
+	return erreurs>0;
+}
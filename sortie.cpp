@@ -0,0 +1,170 @@
+#include "sortie.hpp"
+#include "chronos.hpp"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+bool EcrireSnapshot(const char * fichier, const double * x, int taille, int n, uint64_t empreinte, int pas, double temps, float * tampon){
+	EnteteSnapshot e;
+	memset(&e,0,sizeof(e));
+	memcpy(e.magic,SNAP_MAGIC,sizeof(e.magic));
+	e.version=SNAP_VERSION;
+	e.flags=tampon ? SNAP_FLOAT32 : 0;
+	e.empreinte=empreinte;
+	e.pas=pas;
+	e.temps=temps;
+	e.taille=taille;
+	e.n=n;
+
+	FILE * f=fopen(fichier,"wb");
+	if(f==NULL){
+		cout<<"erreur: impossible d'ouvrir "<<fichier<<endl;
+		return false;
+	}
+	bool ok=(fwrite(&e,sizeof(e),1,f)==1);
+	if(tampon){
+		copy(x,x+taille,tampon);
+		ok=ok && (fwrite(tampon,sizeof(float),taille,f)==(size_t)taille);
+	}
+	else
+		ok=ok && (fwrite(x,sizeof(double),taille,f)==(size_t)taille);
+	ok=(fclose(f)==0) && ok;
+	if(!ok)
+		cout<<"erreur: ecriture de "<<fichier<<" incomplete"<<endl;
+	return ok;
+}
+
+vector<int> PermutationDdl(const Mesh2d & Th, int n){
+	const NumerotationDdl & D=Th.ddl;
+	vector<int> noeuds=Th.NoeudsOriginaux(), perm;
+	if(noeuds.empty() && D.disposition==DDL_BLOCS)
+		return perm;
+	perm.resize(2*n+Th.nv);
+	for(int i=0;i<n;i++){
+		int o=noeuds.empty() ? i : noeuds[i];
+		perm[D.u1(i)]=o;
+		perm[D.u2(i)]=o+n;
+	}
+	for(int i=0;i<Th.nv;i++){
+		perm[D.p(i)]=(noeuds.empty() ? i : noeuds[i])+2*n;
+	}
+	return perm;
+}
+
+void PermuterDdl(const vector<int> & perm, const double * x, double * y, int taille){
+	if(perm.empty()){
+		copy(x,x+taille,y);
+		return;
+	}
+	for(int i=0;i<taille;i++){
+		y[perm[i]]=x[i];
+	}
+}
+
+SnapshotLu::SnapshotLu(const char * fichier) : base_(0), longueur_(0){
+	int fd=open(fichier,O_RDONLY);
+	if(fd<0)
+		return;
+	struct stat st;
+	if(fstat(fd,&st)==0 && st.st_size>=(off_t)sizeof(EnteteSnapshot)){
+		void * p=mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+		if(p!=MAP_FAILED){
+			base_=(const char *)p;
+			longueur_=st.st_size;
+		}
+	}
+	close(fd);
+	if(base_==0)
+		return;
+	const EnteteSnapshot & e=entete();
+	size_t tailleVal=(e.flags & SNAP_FLOAT32) ? sizeof(float) : sizeof(double);
+	if(memcmp(e.magic,SNAP_MAGIC,sizeof(e.magic))!=0 || e.version!=SNAP_VERSION || e.taille<0
+		|| longueur_<sizeof(EnteteSnapshot)+e.taille*tailleVal){ //fichier tronque ou d'un autre format
+		munmap((void *)base_,longueur_);
+		base_=0;
+		longueur_=0;
+	}
+}
+
+SnapshotLu::~SnapshotLu(){
+	if(base_)
+		munmap((void *)base_,longueur_);
+}
+
+
+EcrivainAsync::EcrivainAsync(int taille, int n, uint64_t empreinte, bool simple, int nbTampons)
+	: taille_(taille), n_(n), empreinte_(empreinte), simple_(simple), tampons_(nbTampons),
+		tete_(0), queue_(0), fin_(false), erreurs_(0), attentes_(0){
+	assert(nbTampons>0);
+	for(int i=0;i<nbTampons;i++){
+		tampons_[i].x.resize(taille);
+	}
+	if(simple)
+		xf_.resize(taille);
+	thread_=thread(&EcrivainAsync::boucle,this);
+}
+
+EcrivainAsync::~EcrivainAsync(){
+	terminer();
+}
+
+void EcrivainAsync::soumettre(const string & fichier, const double * x, int pas, double temps){
+	CHRONO("sortie");
+	unsigned tete=tete_.load(memory_order_relaxed);
+	if(tete-queue_.load(memory_order_acquire)>=tampons_.size()){//file pleine: on attend le disque
+		attentes_++;
+		unique_lock<mutex> l(verrou_);
+		libre_.wait(l,[&]{return tete-queue_.load(memory_order_acquire)<tampons_.size();});
+	}
+	Tampon & tp=tampons_[tete%tampons_.size()];
+	tp.fichier=fichier;
+	PermuterDdl(perm_,x,tp.x.data(),taille_);
+	tp.pas=pas;
+	tp.temps=temps;
+	{
+		lock_guard<mutex> l(verrou_);
+		tete_.store(tete+1,memory_order_release);
+	}
+	rempli_.notify_one();
+}
+
+void EcrivainAsync::terminer(){
+	if(!thread_.joinable())
+		return;
+	{
+		lock_guard<mutex> l(verrou_);
+		fin_.store(true,memory_order_release);
+	}
+	rempli_.notify_one();
+	thread_.join();
+}
+
+void EcrivainAsync::boucle(){
+	Chronometrage::nommerThread("ecriture");
+	while(true){
+		unsigned queue=queue_.load(memory_order_relaxed);
+		{
+			unique_lock<mutex> l(verrou_);
+			rempli_.wait(l,[&]{return queue!=tete_.load(memory_order_acquire) || fin_.load(memory_order_acquire);});
+			if(queue==tete_.load(memory_order_acquire)) //fin demandee, file vide
+				return;
+		}
+		Tampon & tp=tampons_[queue%tampons_.size()];
+		CHRONO("sortie");
+		if(!EcrireSnapshot(tp.fichier.c_str(),tp.x.data(),taille_,n_,empreinte_,tp.pas,tp.temps,simple_ ? xf_.data() : 0))
+			erreurs_++;
+		{
+			lock_guard<mutex> l(verrou_);
+			queue_.store(queue+1,memory_order_release);
+		}
+		libre_.notify_one();
+	}
+}
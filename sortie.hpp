@@ -0,0 +1,117 @@
+#ifndef SORTIE_HPP
+#define SORTIE_HPP
+#include "mesh.hpp"
+#include <stdint.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+//////////////////////////////////////// Sorties binaires (snapshots) /////////////////////////
+// Un snapshot contient une valeur par ddl global ([u1 | u2 | p], taille 2n+nv),
+// precedee d'une entete de 64 octets: les donnees sont donc alignees et lisibles par mmap.
+
+#define SNAP_MAGIC "NSSNAP1"
+#define SNAP_VERSION 1
+#define SNAP_FLOAT32 1 // flag: valeurs stockees en float (sinon double)
+
+struct EnteteSnapshot {
+	char magic[8];
+	uint32_t version;
+	uint32_t flags;
+	uint64_t empreinte; // empreinte du maillage (Mesh2d::empreinte)
+	int64_t pas;        // numero du pas de temps
+	double temps;
+	int64_t taille;     // nb de valeurs = 2n+nv
+	int64_t n;          // nb de ddl P2 par composante de vitesse
+	char reserve[8];
+};
+
+//ecrit x[0..taille[ dans fichier; retourne false en cas d'erreur d'ecriture. Avec tampon (taille
+//floats fournis par l'appelant), les valeurs sont converties et stockees en float32.
+bool EcrireSnapshot(const char * fichier, const double * x, int taille, int n, uint64_t empreinte, int pas, double temps, float * tampon=0);
+
+//Permutation des ddl du solveur (Th.ddl) vers les blocs [u1 | u2 | p] dans la numerotation du
+//maillage lu (Mesh2d::Reordonner): le ddl i est ecrit a la position perm[i]. Vide si le maillage
+//n'est pas reordonne et les ddl sont en blocs. Les snapshots et points de reprise restent ainsi
+//dans l'ordre du fichier de maillage.
+vector<int> PermutationDdl(const Mesh2d & Th, int n);
+//y[perm[i]]=x[i] (simple copie si perm est vide)
+void PermuterDdl(const vector<int> & perm, const double * x, double * y, int taille);
+
+//Lecture d'un snapshot par mmap (aucune copie des donnees)
+class SnapshotLu {
+public:
+	SnapshotLu(const char * fichier);
+	~SnapshotLu();
+	bool ok() const {return base_!=0;}
+	const EnteteSnapshot & entete() const {return *(const EnteteSnapshot *)base_;}
+	double operator[](long i) const{
+		if(entete().flags & SNAP_FLOAT32)
+			return ((const float *)(base_+sizeof(EnteteSnapshot)))[i];
+		return ((const double *)(base_+sizeof(EnteteSnapshot)))[i];
+	}
+private:
+	const char * base_;
+	size_t longueur_;
+	SnapshotLu(const SnapshotLu &);
+	void operator=(const SnapshotLu &);
+};
+
+//////////////////////////////////////// Ecriture asynchrone /////////////////////////
+// File bornee (un producteur: le solveur, un consommateur: le thread d'ecriture) de nbTampons
+// solutions pre-allouees. Le solveur copie la solution du pas t puis continue avec le pas t+1
+// pendant l'ecriture; si le disque prend du retard, soumettre() attend qu'un tampon se libere.
+// Les deux cotes dorment sur une variable de condition (tampon libre, tampon rempli): le thread
+// d'ecriture inactif ne se reveille pas.
+class EcrivainAsync {
+public:
+	EcrivainAsync(int taille, int n, uint64_t empreinte, bool simple, int nbTampons=2);
+	~EcrivainAsync(); //vide la file puis arrete le thread
+	void soumettre(const string & fichier, const double * x, int pas, double temps);
+	void permuter(const vector<int> & perm){perm_=perm;} //voir PermutationDdl
+	void terminer();
+	int attentes() const {return attentes_;} //nb de fois ou le solveur a attendu le disque
+	bool ok() const {return erreurs_==0;}
+private:
+	struct Tampon {
+		string fichier;
+		vector<double> x;
+		int pas;
+		double temps;
+	};
+	int taille_, n_;
+	uint64_t empreinte_;
+	bool simple_;
+	vector<Tampon> tampons_;
+	vector<int> perm_;
+	vector<float> xf_;       //conversion float32 (thread d'ecriture)
+	atomic<unsigned> tete_;  //prochain tampon a remplir (producteur)
+	atomic<unsigned> queue_; //prochain tampon a ecrire (consommateur)
+	atomic<bool> fin_;
+	atomic<int> erreurs_;
+	int attentes_;
+	mutex verrou_;           //protege les transitions de tete_, queue_ et fin_ attendues
+	condition_variable libre_, rempli_;
+	thread thread_;
+	void boucle();
+	EcrivainAsync(const EcrivainAsync &);
+	void operator=(const EcrivainAsync &);
+};
+
+//Format texte historique lu par plot/plot.edp: une ligne par triangle avec les 15 valeurs locales (u1 P2, u2 P2, p P1)
+template<class V> void EcrireSolutionTexte(Mesh2d & Th, int n, const V & x, ostream & f){
+	for(int k=0;k<Th.nbt;k++){
+		const int * glob=Th.ddl[k];
+		for(int il=0;il<15;il++){
+			f<<x[glob[il]]<<" ";
+		}
+		f<<"\n";
+	}
+}
+#endif
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+//////////////////////////////////////// Produit matrice creuse - vecteur /////////////////////////
+// Moteur SpMV pour les chemins iteratifs (residus, Krylov, projections) sur le CSR du systeme
+// (celui donne a UMFPACK), en deux formats:
+//  csr:  lignes compressees, indices de colonne sur 32 bits
+//  sell: SELL-C-sigma (C=8 lignes par tranche, stockees par colonnes; lignes triees par longueur
+//        decroissante dans chaque fenetre de sigma lignes pour limiter le remplissage des tranches)
+// Noyaux AVX-512 (8 doubles, gather sur indices 32 bits) ou AVX2 (2 x 4 doubles) selon les options
+// de compilation (make NATIF=1: -march=native), scalaires sinon; lignes ou tranches reparties sur
+// les threads OpenMP (make OPENMP=1). Un produit lit la matrice une fois: il est limite par la
+// bande passante memoire (octets() / temps, a comparer a BM_Triade dans bench).
+// (necessite le type Indice de MatNS.hpp)
+
+#ifdef _OPENMP
+#define NS_OMP_POUR _Pragma("omp parallel for schedule(static)")
+#else
+#define NS_OMP_POUR
+#endif
+
+//x[idx] sur 8 ou 4 doubles; la source nulle explicite evite l'avertissement '__Y may be used
+//uninitialized' des versions sans masque (registre _mm*_undefined_pd)
+#if defined(__AVX512F__)
+static inline __m512d Collecter8(const double * x, __m256i idx){
+	return _mm512_mask_i32gather_pd(_mm512_setzero_pd(),0xFF,idx,x,8);
+}
+#elif defined(__AVX2__) && defined(__FMA__)
+static inline __m256d Collecter4(const double * x, __m128i idx){
+	return _mm256_mask_i32gather_pd(_mm256_setzero_pd(),x,idx,_mm256_castsi256_pd(_mm256_set1_epi64x(-1)),8);
+}
+#endif
+
+enum FormatSpMV {SPMV_CSR, SPMV_SELL};
+
+struct SpMV {
+	static const int C=8;     //lignes par tranche SELL
+	int format, nl, sigma;
+	//csr
+	vector<Indice> p;
+	vector<int> j;
+	vector<double> v;
+	//sell: tranche t de longueur lt = (debut[t+1]-debut[t])/C, terme k de la ligne r de la tranche
+	//en debut[t]+k*C+r; ligne[t*C+r] = ligne d'origine (-1: ligne de bourrage)
+	vector<Indice> debut;
+	vector<int> ligne;
+	SpMV() : format(SPMV_CSR), nl(0), sigma(0) {}
+
+	//a partir d'un CSR (Ap, AI, Ax) a nl lignes
+	void Construire(int format_, int nl_, const Indice * Ap, const Indice * AI, const double * Ax, int sigma_=256){
+		format=format_;
+		nl=nl_;
+		sigma=sigma_;
+		p.clear(); j.clear(); v.clear(); debut.clear(); ligne.clear();
+		if(format==SPMV_CSR){
+			p.assign(Ap,Ap+nl+1);
+			j.assign(AI,AI+Ap[nl]);
+			v.assign(Ax,Ax+Ap[nl]);
+			return;
+		}
+		int nt=(nl+C-1)/C;
+		ligne.resize(nt*C);
+		for(int i=0;i<nt*C;i++){
+			ligne[i]=(i<nl) ? i : -1;
+		}
+		for(int f=0;f<nl;f+=sigma){//tri par longueur decroissante dans chaque fenetre
+			int fin=min(nl,f+sigma);
+			stable_sort(ligne.begin()+f,ligne.begin()+fin,[&](int a, int b){
+				return Ap[a+1]-Ap[a]>Ap[b+1]-Ap[b];
+			});
+		}
+		debut.assign(nt+1,0);
+		for(int t=0;t<nt;t++){
+			Indice lt=0;
+			for(int r=0;r<C;r++){
+				int i=ligne[t*C+r];
+				if(i>=0)
+					lt=max(lt,Ap[i+1]-Ap[i]);
+			}
+			debut[t+1]=debut[t]+lt*C;
+		}
+		j.assign(debut[nt],0);
+		v.assign(debut[nt],0.); //bourrage: colonne 0, valeur 0
+		for(int t=0;t<nt;t++){
+			for(int r=0;r<C;r++){
+				int i=ligne[t*C+r];
+				if(i<0)
+					continue;
+				for(Indice q=Ap[i];q<Ap[i+1];q++){
+					j[debut[t]+(q-Ap[i])*C+r]=AI[q];
+					v[debut[t]+(q-Ap[i])*C+r]=Ax[q];
+				}
+			}
+		}
+	}
+
+	//octets lus et ecrits par un produit (matrice, x une fois, y)
+	double octets() const {
+		double m=v.size()*(sizeof(double)+sizeof(int))+p.size()*sizeof(Indice)+(debut.size()*sizeof(Indice)+ligne.size()*sizeof(int));
+		return m+2.*nl*sizeof(double);
+	}
+	//termes stockes / termes non nuls (remplissage des tranches SELL)
+	double remplissage(Indice nnz) const {return (double)v.size()/max(nnz,(Indice)1);}
+
+	void Produit(const double * x, double * y) const {
+		if(format==SPMV_CSR)
+			ProduitCSR(x,y);
+		else
+			ProduitSELL(x,y);
+	}
+
+	void ProduitCSR(const double * x, double * y) const {
+		const Indice * pp=p.data();
+		const int * jj=j.data();
+		const double * vv=v.data();
+		NS_OMP_POUR
+		for(int i=0;i<nl;i++){
+			Indice q=pp[i], fin=pp[i+1];
+			double s=0;
+#if defined(__AVX512F__)
+			__m512d acc=_mm512_setzero_pd();
+			for(;q+8<=fin;q+=8){
+				__m256i idx=_mm256_loadu_si256((const __m256i *)(jj+q));
+				acc=_mm512_fmadd_pd(_mm512_loadu_pd(vv+q),Collecter8(x,idx),acc);
+			}
+			double t[8];
+			_mm512_storeu_pd(t,acc);
+			s=((t[0]+t[1])+(t[2]+t[3]))+((t[4]+t[5])+(t[6]+t[7]));
+#elif defined(__AVX2__) && defined(__FMA__)
+			__m256d acc=_mm256_setzero_pd();
+			for(;q+4<=fin;q+=4){
+				__m128i idx=_mm_loadu_si128((const __m128i *)(jj+q));
+				acc=_mm256_fmadd_pd(_mm256_loadu_pd(vv+q),Collecter4(x,idx),acc);
+			}
+			double t[4];
+			_mm256_storeu_pd(t,acc);
+			s=(t[0]+t[1])+(t[2]+t[3]);
+#endif
+			for(;q<fin;q++){
+				s+=vv[q]*x[jj[q]];
+			}
+			y[i]=s;
+		}
+	}
+
+	void ProduitSELL(const double * x, double * y) const {
+		const int * jj=j.data();
+		const double * vv=v.data();
+		int nt=debut.size()-1;
+		NS_OMP_POUR
+		for(int t=0;t<nt;t++){
+			double s[C];
+#if defined(__AVX512F__)
+			__m512d acc=_mm512_setzero_pd();
+			for(Indice q=debut[t];q<debut[t+1];q+=C){
+				__m256i idx=_mm256_loadu_si256((const __m256i *)(jj+q));
+				acc=_mm512_fmadd_pd(_mm512_loadu_pd(vv+q),Collecter8(x,idx),acc);
+			}
+			_mm512_storeu_pd(s,acc);
+#elif defined(__AVX2__) && defined(__FMA__)
+			__m256d a0=_mm256_setzero_pd(), a1=_mm256_setzero_pd();
+			for(Indice q=debut[t];q<debut[t+1];q+=C){
+				a0=_mm256_fmadd_pd(_mm256_loadu_pd(vv+q),Collecter4(x,_mm_loadu_si128((const __m128i *)(jj+q))),a0);
+				a1=_mm256_fmadd_pd(_mm256_loadu_pd(vv+q+4),Collecter4(x,_mm_loadu_si128((const __m128i *)(jj+q+4))),a1);
+			}
+			_mm256_storeu_pd(s,a0);
+			_mm256_storeu_pd(s+4,a1);
+#else
+			for(int r=0;r<C;r++){
+				s[r]=0;
+			}
+			for(Indice q=debut[t];q<debut[t+1];q+=C){
+				for(int r=0;r<C;r++){
+					s[r]+=vv[q+r]*x[jj[q+r]];
+				}
+			}
+#endif
+			for(int r=0;r<C;r++){
+				int i=ligne[t*C+r];
+				if(i>=0)
+					y[i]=s[r];
+			}
+		}
+	}
+};
+
+//||A x - b||_2 / ||b||_2 (||A x - b||_2 si b est nul); r: tampon de taille A.nl
+double ResiduRelatif(const SpMV & A, const double * x, const double * b, double * r){
+	A.Produit(x,r);
+	double nr=0, nb=0;
+	for(int i=0;i<A.nl;i++){
+		nr+=(r[i]-b[i])*(r[i]-b[i]);
+		nb+=b[i]*b[i];
+	}
+	return nb>0 ? sqrt(nr/nb) : sqrt(nr);
+}
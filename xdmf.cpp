@@ -0,0 +1,148 @@
+#include "xdmf.hpp"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#ifdef NS_HDF5
+#include "hdf5.h"
+#endif
+
+using namespace std;
+
+#ifdef NS_HDF5
+//jeu de donnees 2D (lignes x colonnes) decoupe en blocs de lignes, compresse si niveau>0
+static bool EcrireDataset(hid_t parent, const char * nom, hid_t type, const void * donnees, hsize_t lignes, hsize_t colonnes, int compression){
+	hsize_t dims[2]={lignes,colonnes};
+	hid_t espace=H5Screate_simple(colonnes>1 ? 2 : 1,dims,NULL);
+	hid_t prop=H5Pcreate(H5P_DATASET_CREATE);
+	if(lignes>0){
+		hsize_t bloc[2]={min(lignes,(hsize_t)65536),colonnes};
+		H5Pset_chunk(prop,colonnes>1 ? 2 : 1,bloc);
+		if(compression>0 && H5Zfilter_avail(H5Z_FILTER_DEFLATE)){
+			H5Pset_shuffle(prop);
+			H5Pset_deflate(prop,compression);
+		}
+	}
+	hid_t ds=H5Dcreate2(parent,nom,type,espace,H5P_DEFAULT,prop,H5P_DEFAULT);
+	bool ok=(ds>=0) && H5Dwrite(ds,type,H5S_ALL,H5S_ALL,H5P_DEFAULT,donnees)>=0;
+	if(ds>=0)
+		H5Dclose(ds);
+	H5Pclose(prop);
+	H5Sclose(espace);
+	return ok;
+}
+#endif
+
+SortieXdmf::SortieXdmf(const string & base, Mesh2d & Th, int n, int compression)
+	: base_(base), fichier_(-1), n_(n), nv_(Th.nv), nbt_(Th.nbt), compression_(compression), entrelace_(Th.ddl.disposition==DDL_ENTRELACE){
+#ifdef NS_HDF5
+	extremites_.assign(2*(n-Th.nv),0);
+	vector<double> noeuds(2*n);
+	vector<int> triangles(6*Th.nbt);
+	for(int i=0;i<n;i++){
+		noeuds[2*i]=Th.v[i].getX();
+		noeuds[2*i+1]=Th.v[i].getY();
+	}
+	for(int k=0;k<Th.nbt;k++){
+		for(int a=0;a<3;a++){
+			triangles[6*k+a]=Th(k,a);
+			int m=Th(k,3+a)-Th.nv; //milieu de l'arete opposee au sommet a
+			extremites_[2*m]=Th(k,(a+1)%3);
+			extremites_[2*m+1]=Th(k,(a+2)%3);
+		}
+		triangles[6*k+3]=Th(k,5); //ordre Triangle_6: milieux de [v0 v1], [v1 v2], [v2 v0]
+		triangles[6*k+4]=Th(k,3);
+		triangles[6*k+5]=Th(k,4);
+	}
+	string nom=base+".h5";
+	hid_t f=H5Fcreate(nom.c_str(),H5F_ACC_TRUNC,H5P_DEFAULT,H5P_DEFAULT);
+	if(f<0){
+		cout<<"erreur: impossible de creer "<<nom<<endl;
+		return;
+	}
+	hid_t g=H5Gcreate2(f,"/maillage",H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+	bool ok=EcrireDataset(g,"noeuds",H5T_NATIVE_DOUBLE,noeuds.data(),n,2,compression)
+		&& EcrireDataset(g,"triangles",H5T_NATIVE_INT,triangles.data(),Th.nbt,6,compression);
+	H5Gclose(g);
+	if(!ok){
+		cout<<"erreur: ecriture du maillage dans "<<nom<<endl;
+		H5Fclose(f);
+		return;
+	}
+	fichier_=f;
+	tampon_.resize(2*n);
+#else
+	cout<<"sortie XDMF indisponible: recompiler avec make HDF5=1"<<endl;
+#endif
+}
+
+SortieXdmf::~SortieXdmf(){
+#ifdef NS_HDF5
+	if(fichier_>=0)
+		H5Fclose(fichier_);
+#endif
+}
+
+void SortieXdmf::ecrire(const double * x, int pas, double temps){
+#ifdef NS_HDF5
+	if(fichier_<0)
+		return;
+	string nom="/pas_"+to_string(pas);
+	hid_t g=H5Gcreate2(fichier_,nom.c_str(),H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+	if(g<0){
+		cout<<"erreur: groupe "<<nom<<" deja present"<<endl;
+		return;
+	}
+	if(!entrelace_){
+		for(int i=0;i<n_;i++){//vitesse: [u1 | u2] -> (u1,u2) par noeud
+			tampon_[2*i]=x[i];
+			tampon_[2*i+1]=x[i+n_];
+		}
+	}
+	bool ok=EcrireDataset(g,"vitesse",H5T_NATIVE_DOUBLE,entrelace_ ? x : tampon_.data(),n_,2,compression_);
+	const double * p=x+2*n_;
+	for(int i=0;i<nv_;i++){
+		tampon_[i]=p[i];
+	}
+	for(int m=0;m<n_-nv_;m++){//P1 prolongee: moyenne des extremites de l'arete
+		tampon_[nv_+m]=0.5*(p[extremites_[2*m]]+p[extremites_[2*m+1]]);
+	}
+	ok=EcrireDataset(g,"pression",H5T_NATIVE_DOUBLE,tampon_.data(),n_,1,compression_) && ok;
+	H5Gclose(g);
+	H5Fflush(fichier_,H5F_SCOPE_GLOBAL);
+	if(!ok){
+		cout<<"erreur: ecriture du pas "<<pas<<" dans "<<base_<<".h5"<<endl;
+		return;
+	}
+	pas_.push_back(pas);
+	temps_.push_back(temps);
+	ecrireIndex();
+#else
+	(void)x; (void)pas; (void)temps;
+#endif
+}
+
+void SortieXdmf::ecrireIndex(){
+	string h5=base_.substr(base_.find_last_of('/')+1)+".h5"; //chemin relatif au .xmf
+	string nom=base_+".xmf";
+	string tmp=nom+".tmp";
+	ofstream f(tmp.c_str());
+	f<<"<?xml version=\"1.0\" ?>\n<Xdmf Version=\"3.0\">\n<Domain>\n";
+	f<<"<Grid Name=\"NS\" GridType=\"Collection\" CollectionType=\"Temporal\">\n";
+	for(unsigned int s=0;s<pas_.size();s++){
+		f<<" <Grid Name=\"pas_"<<pas_[s]<<"\" GridType=\"Uniform\">\n";
+		f<<"  <Time Value=\""<<temps_[s]<<"\"/>\n";
+		f<<"  <Topology TopologyType=\"Triangle_6\" NumberOfElements=\""<<nbt_<<"\">\n";
+		f<<"   <DataItem Dimensions=\""<<nbt_<<" 6\" NumberType=\"Int\" Format=\"HDF\">"<<h5<<":/maillage/triangles</DataItem>\n  </Topology>\n";
+		f<<"  <Geometry GeometryType=\"XY\">\n";
+		f<<"   <DataItem Dimensions=\""<<n_<<" 2\" NumberType=\"Float\" Precision=\"8\" Format=\"HDF\">"<<h5<<":/maillage/noeuds</DataItem>\n  </Geometry>\n";
+		f<<"  <Attribute Name=\"vitesse\" AttributeType=\"Vector\" Center=\"Node\">\n";
+		f<<"   <DataItem Dimensions=\""<<n_<<" 2\" NumberType=\"Float\" Precision=\"8\" Format=\"HDF\">"<<h5<<":/pas_"<<pas_[s]<<"/vitesse</DataItem>\n  </Attribute>\n";
+		f<<"  <Attribute Name=\"pression\" AttributeType=\"Scalar\" Center=\"Node\">\n";
+		f<<"   <DataItem Dimensions=\""<<n_<<"\" NumberType=\"Float\" Precision=\"8\" Format=\"HDF\">"<<h5<<":/pas_"<<pas_[s]<<"/pression</DataItem>\n  </Attribute>\n";
+		f<<" </Grid>\n";
+	}
+	f<<"</Grid>\n</Domain>\n</Xdmf>\n";
+	f.close();
+	rename(tmp.c_str(),nom.c_str());
+}
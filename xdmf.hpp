@@ -0,0 +1,34 @@
+#ifndef XDMF_HPP
+#define XDMF_HPP
+#include "mesh.hpp"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//////////////////////////////////////// Sortie XDMF/HDF5 pour ParaView /////////////////////////
+// Un seul fichier <base>.h5: le maillage P2 (noeuds + triangles a 6 noeuds) est ecrit une fois,
+// puis chaque pas ajoute le groupe /pas_<t> avec la vitesse P2 (n x 2) et la pression P1
+// prolongee aux points milieux. <base>.xmf est l'index temporel lu par ParaView, reecrit a
+// chaque pas pour rester valide si le calcul s'arrete.
+// Disponible seulement si compile avec -DNS_HDF5 (make HDF5=1).
+class SortieXdmf {
+public:
+	SortieXdmf(const string & base, Mesh2d & Th, int n, int compression=0);
+	~SortieXdmf();
+	bool ok() const {return fichier_>=0;}
+	void ecrire(const double * x, int pas, double temps);
+private:
+	string base_;
+	long fichier_; //hid_t du fichier HDF5 (<0 si indisponible)
+	int n_, nv_, nbt_, compression_;
+	bool entrelace_; //ddl DDL_ENTRELACE: la vitesse est deja (u1,u2) par noeud
+	vector<int> extremites_; //2 sommets par point milieu, pour prolonger la pression P1
+	vector<double> tampon_;
+	vector<int> pas_;
+	vector<double> temps_;
+	void ecrireIndex();
+	SortieXdmf(const SortieXdmf &);
+	void operator=(const SortieXdmf &);
+};
+#endif